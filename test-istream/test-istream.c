@@ -21,6 +21,8 @@
  *
  */
 
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -52,28 +54,282 @@ static int start_fn(void* priv, int line, float progress,
 
 static int end_fn(void* priv, int line, float progress,
                   const char* name,
-                  const char* content)
+                  const char* content,
+                  size_t len)
 {
 	LOGI("line=%i, progress=%f, name=%s",
 	     line, progress, name);
 
 	if(content)
 	{
-		LOGI("content=%s", content);
+		LOGI("content=%s, len=%i", content, (int) len);
 	}
 
 	return 1;
 }
 
+// event log used to compare the scanner with expat which
+// grows to hold the events of the whole document
+typedef struct
+{
+	char*  buf;
+	size_t len;
+	size_t size;
+	int    error;
+} test_log_t;
+
+static void test_logf(test_log_t* log, const char* fmt, ...)
+{
+	if(log->error)
+	{
+		return;
+	}
+
+	va_list argptr;
+	va_start(argptr, fmt);
+	int n = vsnprintf(NULL, 0, fmt, argptr);
+	va_end(argptr);
+	if(n <= 0)
+	{
+		return;
+	}
+
+	size_t need = log->len + (size_t) n + 1;
+	if(need > log->size)
+	{
+		size_t size = log->size ? 2*log->size : 4096;
+		while(size < need)
+		{
+			size *= 2;
+		}
+
+		char* buf = (char*) realloc(log->buf, size);
+		if(buf == NULL)
+		{
+			LOGE("realloc failed");
+			log->error = 1;
+			return;
+		}
+		log->buf  = buf;
+		log->size = size;
+	}
+
+	va_start(argptr, fmt);
+	vsnprintf(&log->buf[log->len], log->size - log->len,
+	          fmt, argptr);
+	va_end(argptr);
+	log->len += (size_t) n;
+}
+
+static int log_start_fn(void* priv, int line, float progress,
+                        const char* name,
+                        const char** atts)
+{
+	test_log_t* log = (test_log_t*) priv;
+	test_logf(log, "S %s %i", name, line);
+
+	int i = 0;
+	while(atts[i] && atts[i + 1])
+	{
+		test_logf(log, " %s=[%s]", atts[i], atts[i + 1]);
+		i += 2;
+	}
+	test_logf(log, "\n");
+
+	return 1;
+}
+
+static int log_end_fn(void* priv, int line, float progress,
+                      const char* name,
+                      const char* content,
+                      size_t len)
+{
+	test_log_t* log = (test_log_t*) priv;
+	test_logf(log, "E %s %i [%s]\n", name, line,
+	          content ? content : "");
+	return 1;
+}
+
+// documents which exercise the scanner and its fallback
+// where the length allows embedded NUL characters
+typedef struct
+{
+	const char* doc;
+	size_t      len;
+} test_doc_t;
+
+#define TEST_DOC(doc) { doc, sizeof(doc) - 1 }
+
+static const test_doc_t TEST_SCANNER_DOC[] =
+{
+	TEST_DOC("<r>\n<a\n x='1'\n/>\n<b y='p\nq'/>\n</r>\n"),
+	TEST_DOC("<r a='&lt;&#65;&#x42;'>x &amp; y<!-- c --><?pi d?>\n"
+	         "<e/><f>1</f>\n</r>"),
+	TEST_DOC("<r><c>a>b ]>]] ></c></r>"),
+	TEST_DOC("<r><c>x]]>y</c></r>"),
+	TEST_DOC("<r><c><![CDATA[<x>]]></c></r>"),
+	TEST_DOC("<r>\r\n<c>a</c>\r\n</r>"),
+	TEST_DOC("<r><a></b></r>"),
+	TEST_DOC("<r><a x='1' x='2'/></r>"),
+	TEST_DOC("<r/><junk/>"),
+	TEST_DOC("<r>\x01</r>"),
+	TEST_DOC("<r a='\x01'/>"),
+	TEST_DOC("<r>a\0b</r>"),
+	TEST_DOC("<r>\t0123456789abcdef\x1f</r>"),
+	TEST_DOC("<r><!-- \x01 --></r>"),
+	TEST_DOC("<r><?pi \x02?></r>"),
+	TEST_DOC("<r>\xff\xfe</r>"),
+	TEST_DOC("<r>\xc0\xaf</r>"),
+	TEST_DOC("<r>\xed\xa0\x80</r>"),
+	TEST_DOC("<r>\xef\xbf\xbe</r>"),
+	TEST_DOC("<r>\xf4\x90\x80\x80</r>"),
+	TEST_DOC("<r>\xe2\x82</r>"),
+	TEST_DOC("<r a='\xc3\xa9\xed\xa0\x80'/>"),
+	TEST_DOC("<r a='\xc3\xa9'>\xc3\xa9" "0123456789abcdef"
+	         "\xe2\x82\xac\xf0\x9f\x98\x80</r>"),
+	TEST_DOC("<\xc3\xa9><a>1</a></\xc3\xa9>"),
+	{ NULL, 0 },
+};
+
+static int
+test_scanner_read(const char* buffer, size_t size,
+                  int scanner, test_log_t* log)
+{
+	log->len = 0;
+
+	xml_istream_t* is = xml_istream_new((void*) log,
+	                                    log_start_fn,
+	                                    log_end_fn);
+	if(is == NULL)
+	{
+		return -1;
+	}
+
+	if(scanner && (xml_istream_scanner(is, 1) == 0))
+	{
+		xml_istream_delete(&is);
+		return -1;
+	}
+
+	int ret = xml_istream_readBuffer(is, buffer, size);
+	xml_istream_delete(&is);
+	return ret;
+}
+
+// length of the event starting at offset
+static int test_scanner_event(test_log_t* log, size_t offset)
+{
+	size_t i = offset;
+	while((i < log->len) && (log->buf[i] != '\n'))
+	{
+		++i;
+	}
+	return (int) (i - offset);
+}
+
+// compares the events of the scanner and expat
+static int test_scanner(const char* buffer, size_t size)
+{
+	static test_log_t log0;
+	static test_log_t log1;
+
+	int ret0 = test_scanner_read(buffer, size, 0, &log0);
+	int ret1 = test_scanner_read(buffer, size, 1, &log1);
+	if(log0.error || log1.error)
+	{
+		return 0;
+	}
+
+	// find the first event which differs
+	size_t n = (log0.len < log1.len) ? log0.len : log1.len;
+	size_t i = 0;
+	size_t e = 0;
+	while((i < n) && (log0.buf[i] == log1.buf[i]))
+	{
+		if(log0.buf[i] == '\n')
+		{
+			e = i + 1;
+		}
+		++i;
+	}
+
+	if((ret0 != ret1) || (log0.len != log1.len) || (i < n))
+	{
+		LOGE("mismatch: expat ret=%i, scanner ret=%i",
+		     ret0, ret1);
+		LOGE("expat:   %.*s", test_scanner_event(&log0, e),
+		     log0.len ? &log0.buf[e] : "");
+		LOGE("scanner: %.*s", test_scanner_event(&log1, e),
+		     log1.len ? &log1.buf[e] : "");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int test_scannerFile(const char* fname)
+{
+	FILE* f = fopen(fname, "r");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", fname);
+		return 0;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char* buffer = (char*) malloc(size + 1);
+	if((buffer == NULL) ||
+	   (fread(buffer, size, 1, f) != 1))
+	{
+		LOGE("read %s failed", fname);
+		free(buffer);
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+
+	int ret = test_scanner(buffer, (size_t) size);
+	free(buffer);
+	return ret;
+}
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
 
 int main(int argc, char** argv)
 {
-	if(argc != 2)
+	if((argc >= 2) && (strcmp(argv[1], "-scanner") == 0))
+	{
+		int ret = EXIT_SUCCESS;
+		if(argc == 3)
+		{
+			if(test_scannerFile(argv[2]) == 0)
+			{
+				ret = EXIT_FAILURE;
+			}
+			return ret;
+		}
+
+		int i = 0;
+		while(TEST_SCANNER_DOC[i].doc)
+		{
+			const test_doc_t* doc = &TEST_SCANNER_DOC[i];
+			if(test_scanner(doc->doc, doc->len) == 0)
+			{
+				LOGE("doc %i failed", i);
+				ret = EXIT_FAILURE;
+			}
+			++i;
+		}
+		return ret;
+	}
+	else if(argc != 2)
 	{
-		LOGE("usage: %s <test.xml>", argv[0]);
+		LOGE("usage: %s [-scanner] <test.xml>", argv[0]);
 		return EXIT_FAILURE;
 	}
 
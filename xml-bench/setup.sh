@@ -0,0 +1,3 @@
+ln -s ../../libcc
+ln -s ../../libxmlstream
+ln -s ../../libexpat
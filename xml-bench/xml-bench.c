@@ -0,0 +1,938 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "xml-bench"
+#include "libcc/cc_log.h"
+#include "libxmlstream/xml_istream.h"
+#include "libxmlstream/xml_ostream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+	#define XML_BENCH_CYCLES
+#endif
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+// corpora
+#define XML_BENCH_CORPUS_OSM   0
+#define XML_BENCH_CORPUS_DEEP  1
+#define XML_BENCH_CORPUS_ATTS  2
+#define XML_BENCH_CORPUS_TEXT  3
+#define XML_BENCH_CORPUS_COUNT 4
+
+static const char* XML_BENCH_CORPUS_NAME[] =
+{
+	"osm",
+	"deep",
+	"atts",
+	"text",
+};
+
+// approximate bytes per record used to size the corpora
+static const size_t XML_BENCH_CORPUS_RECORD[] =
+{
+	128,
+	1900,
+	350,
+	16800,
+};
+
+// ostream modes
+#define XML_BENCH_OSTREAM_NEW    0
+#define XML_BENCH_OSTREAM_GZ     1
+#define XML_BENCH_OSTREAM_FILE   2
+#define XML_BENCH_OSTREAM_BUFFER 3
+#define XML_BENCH_OSTREAM_COUNT  4
+
+static const char* XML_BENCH_OSTREAM_NAME[] =
+{
+	"xml_ostream_new",
+	"xml_ostream_newGz",
+	"xml_ostream_newFile",
+	"xml_ostream_newBuffer",
+};
+
+// escape kernels
+#define XML_BENCH_KERNEL_COUNT 4
+
+static const int XML_BENCH_KERNEL[] =
+{
+	XML_OSTREAM_KERNEL_SCALAR,
+	XML_OSTREAM_KERNEL_SSE2,
+	XML_OSTREAM_KERNEL_AVX2,
+	XML_OSTREAM_KERNEL_NEON,
+};
+
+static const char* XML_BENCH_KERNEL_NAME[] =
+{
+	"scalar",
+	"sse2",
+	"avx2",
+	"neon",
+};
+
+// escape values with no special characters (clean), one
+// special character per 256 bytes (sparse) or one per 16
+// bytes (dense)
+#define XML_BENCH_ESCAPE_COUNT 3
+
+static const char* XML_BENCH_ESCAPE_NAME[] =
+{
+	"clean",
+	"sparse",
+	"dense",
+};
+
+static const size_t XML_BENCH_ESCAPE_PERIOD[] =
+{
+	0,
+	256,
+	16,
+};
+
+// istream entry points
+#define XML_BENCH_ISTREAM_PARSE       0
+#define XML_BENCH_ISTREAM_GZ          1
+#define XML_BENCH_ISTREAM_ZSTD        2
+#define XML_BENCH_ISTREAM_LZ4         3
+#define XML_BENCH_ISTREAM_FILE        4
+#define XML_BENCH_ISTREAM_BUFFER      5
+#define XML_BENCH_ISTREAM_SLICE       6
+#define XML_BENCH_ISTREAM_COUNT       7
+
+static const char* XML_BENCH_ISTREAM_NAME[] =
+{
+	"xml_istream_parse",
+	"xml_istream_parseGz",
+	"xml_istream_parseZstd",
+	"xml_istream_parseLz4",
+	"xml_istream_parseFile",
+	"xml_istream_parseBuffer",
+	"xml_istream_parseBufferSlice",
+};
+
+// the input file suffix for each istream entry point
+// where zstd and LZ4 input is only measured when the
+// corpus was compressed externally (e.g. zstd osm.xml)
+static const char* XML_BENCH_ISTREAM_SUFFIX[] =
+{
+	".xml",
+	".xml.gz",
+	".xml.zst",
+	".xml.lz4",
+	".xml",
+	".xml",
+	".xml",
+};
+
+/***********************************************************
+* allocation counting                                      *
+***********************************************************/
+
+// allocations are counted by interposing the glibc
+// allocator which also counts expat, zlib and libcc
+#ifdef __GLIBC__
+	extern void* __libc_malloc(size_t size);
+	extern void* __libc_calloc(size_t nmemb, size_t size);
+	extern void* __libc_realloc(void* ptr, size_t size);
+
+	static int64_t xml_bench_allocs;
+
+	void* malloc(size_t size)
+	{
+		__atomic_add_fetch(&xml_bench_allocs, 1,
+		                   __ATOMIC_RELAXED);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t nmemb, size_t size)
+	{
+		__atomic_add_fetch(&xml_bench_allocs, 1,
+		                   __ATOMIC_RELAXED);
+		return __libc_calloc(nmemb, size);
+	}
+
+	void* realloc(void* ptr, size_t size)
+	{
+		__atomic_add_fetch(&xml_bench_allocs, 1,
+		                   __ATOMIC_RELAXED);
+		return __libc_realloc(ptr, size);
+	}
+#else
+	static int64_t xml_bench_allocs = -1;
+#endif
+
+/***********************************************************
+* measurement                                              *
+***********************************************************/
+
+typedef struct
+{
+	double  t0;
+	int64_t allocs;
+	int64_t events;
+} xml_bench_t;
+
+static double xml_bench_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + ((double) ts.tv_nsec)/1.0e9;
+}
+
+static void xml_bench_begin(xml_bench_t* self)
+{
+	ASSERT(self);
+
+	self->events = 0;
+	self->allocs = xml_bench_allocs;
+	self->t0     = xml_bench_time();
+}
+
+// reports the throughput of bytes of uncompressed xml
+static void
+xml_bench_report(xml_bench_t* self, const char* corpus,
+                 const char* name, size_t bytes)
+{
+	ASSERT(self);
+	ASSERT(corpus);
+	ASSERT(name);
+
+	double  dt     = xml_bench_time() - self->t0;
+	int64_t allocs = xml_bench_allocs - self->allocs;
+
+	// each case runs in a child process so the peak RSS
+	// is not shared between cases
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	double mbs = ((double) bytes)/(1024.0*1024.0)/dt;
+	double evs = ((double) self->events)/dt;
+	if(xml_bench_allocs >= 0)
+	{
+		double ape = self->events ?
+		             ((double) allocs)/((double) self->events) :
+		             0.0;
+		printf("%-5s %-29s %9.1f %12.0f %10.4f %9li\n",
+		       corpus, name, mbs, evs, ape,
+		       (long) usage.ru_maxrss);
+	}
+	else
+	{
+		printf("%-5s %-29s %9.1f %12.0f %10s %9li\n",
+		       corpus, name, mbs, evs, "n/a",
+		       (long) usage.ru_maxrss);
+	}
+	fflush(stdout);
+}
+
+/***********************************************************
+* corpus generator                                         *
+***********************************************************/
+
+// deterministic LCG so that every run writes the same corpora
+static uint32_t xml_bench_rand(uint32_t* seed)
+{
+	ASSERT(seed);
+
+	*seed = 1664525u*(*seed) + 1013904223u;
+	return *seed >> 8;
+}
+
+static int
+xml_bench_begin_elem(xml_ostream_t* os, xml_bench_t* bench,
+                     const char* name)
+{
+	ASSERT(os);
+	ASSERT(bench);
+	ASSERT(name);
+
+	// start and end events
+	bench->events += 2;
+	return xml_ostream_begin(os, name);
+}
+
+static int
+xml_bench_generateOsm(xml_ostream_t* os, xml_bench_t* bench,
+                      uint32_t* seed)
+{
+	ASSERT(os);
+	ASSERT(bench);
+	ASSERT(seed);
+
+	static const char* key[] =
+	{
+		"highway",
+		"name",
+		"surface",
+		"maxspeed",
+	};
+
+	uint32_t id = (uint32_t) bench->events;
+	xml_bench_begin_elem(os, bench, "node");
+	xml_ostream_attrf(os, "id", "%u", id);
+	xml_ostream_attrf(os, "lat", "%.7f",
+	                  ((double) (xml_bench_rand(seed)%1800000))/
+	                  10000.0 - 90.0);
+	xml_ostream_attrf(os, "lon", "%.7f",
+	                  ((double) (xml_bench_rand(seed)%3600000))/
+	                  10000.0 - 180.0);
+	xml_ostream_attrf(os, "user", "user%u",
+	                  xml_bench_rand(seed)%1000);
+
+	int i;
+	int ntags = xml_bench_rand(seed)%4;
+	for(i = 0; i < ntags; ++i)
+	{
+		xml_bench_begin_elem(os, bench, "tag");
+		xml_ostream_attr(os, "k", key[i]);
+		xml_ostream_attrf(os, "v", "v%u",
+		                  xml_bench_rand(seed)%10000);
+		xml_ostream_end(os);
+	}
+
+	return xml_ostream_end(os);
+}
+
+static int
+xml_bench_generateDeep(xml_ostream_t* os, xml_bench_t* bench,
+                       uint32_t* seed)
+{
+	ASSERT(os);
+	ASSERT(bench);
+	ASSERT(seed);
+
+	int depth = 16 + xml_bench_rand(seed)%32;
+
+	int i;
+	for(i = 0; i < depth; ++i)
+	{
+		xml_bench_begin_elem(os, bench, "level");
+		xml_ostream_attrf(os, "d", "%i", i);
+	}
+
+	xml_ostream_contentf(os, "leaf %u", xml_bench_rand(seed));
+
+	for(i = 0; i < depth; ++i)
+	{
+		xml_ostream_end(os);
+	}
+
+	return os->error ? 0 : 1;
+}
+
+static int
+xml_bench_generateAtts(xml_ostream_t* os, xml_bench_t* bench,
+                       uint32_t* seed)
+{
+	ASSERT(os);
+	ASSERT(bench);
+	ASSERT(seed);
+
+	xml_bench_begin_elem(os, bench, "item");
+
+	char name[16];
+	int  i;
+	for(i = 0; i < 24; ++i)
+	{
+		snprintf(name, 16, "a%i", i);
+		xml_ostream_attrf(os, name, "%u",
+		                  xml_bench_rand(seed));
+	}
+
+	return xml_ostream_end(os);
+}
+
+static int
+xml_bench_generateText(xml_ostream_t* os, xml_bench_t* bench,
+                       uint32_t* seed, const char* words)
+{
+	ASSERT(os);
+	ASSERT(bench);
+	ASSERT(seed);
+	ASSERT(words);
+
+	xml_bench_begin_elem(os, bench, "p");
+
+	// the text node is written in a single call
+	char text[16000];
+	int  i;
+	for(i = 0; i < 80; ++i)
+	{
+		int offset = xml_bench_rand(seed)%3800;
+		memcpy(&text[200*i], &words[offset], 200);
+	}
+
+	return xml_ostream_contentn(os, text, sizeof(text)) &&
+	       xml_ostream_end(os);
+}
+
+static int
+xml_bench_generate(xml_ostream_t* os, xml_bench_t* bench,
+                   int corpus, size_t size)
+{
+	ASSERT(os);
+	ASSERT(bench);
+
+	uint32_t seed = 1;
+
+	// words for text nodes
+	char words[4096];
+	int  i;
+	for(i = 0; i < 4095; ++i)
+	{
+		uint32_t r = xml_bench_rand(&seed)%32;
+		words[i] = (r < 6) ? ' ' : (char) ('a' + r%26);
+	}
+	words[4095] = '\0';
+
+	int64_t records = (int64_t)
+	                  (size/XML_BENCH_CORPUS_RECORD[corpus]);
+
+	xml_bench_begin_elem(os, bench,
+	                     XML_BENCH_CORPUS_NAME[corpus]);
+	xml_ostream_attr(os, "generator", "xml-bench");
+
+	int64_t r;
+	for(r = 0; r < records; ++r)
+	{
+		int ret;
+		if(corpus == XML_BENCH_CORPUS_OSM)
+		{
+			ret = xml_bench_generateOsm(os, bench, &seed);
+		}
+		else if(corpus == XML_BENCH_CORPUS_DEEP)
+		{
+			ret = xml_bench_generateDeep(os, bench, &seed);
+		}
+		else if(corpus == XML_BENCH_CORPUS_ATTS)
+		{
+			ret = xml_bench_generateAtts(os, bench, &seed);
+		}
+		else
+		{
+			ret = xml_bench_generateText(os, bench, &seed,
+			                             words);
+		}
+
+		if(ret == 0)
+		{
+			return 0;
+		}
+	}
+
+	return xml_ostream_end(os) && xml_ostream_complete(os);
+}
+
+/***********************************************************
+* benchmarks                                               *
+***********************************************************/
+
+static int
+xml_bench_start(void* priv, int line, float progress,
+                const char* name, const char** atts)
+{
+	ASSERT(priv);
+
+	xml_bench_t* bench = (xml_bench_t*) priv;
+	++bench->events;
+	return 1;
+}
+
+static int
+xml_bench_end(void* priv, int line, float progress,
+              const char* name, const char* content,
+              size_t len)
+{
+	ASSERT(priv);
+
+	xml_bench_t* bench = (xml_bench_t*) priv;
+	++bench->events;
+	return 1;
+}
+
+static size_t xml_bench_size(const char* fname)
+{
+	ASSERT(fname);
+
+	struct stat st;
+	if(stat(fname, &st) == -1)
+	{
+		return 0;
+	}
+	return (size_t) st.st_size;
+}
+
+static int
+xml_bench_ostream(const char* dir, int corpus, int mode,
+                  size_t size)
+{
+	ASSERT(dir);
+
+	const char* cname = XML_BENCH_CORPUS_NAME[corpus];
+
+	char fname[256];
+	char gzname[256];
+	char tmpname[256];
+	snprintf(fname,   256, "%s/%s.xml",     dir, cname);
+	snprintf(gzname,  256, "%s/%s.xml.gz",  dir, cname);
+	snprintf(tmpname, 256, "%s/%s-tmp.xml", dir, cname);
+
+	xml_bench_t bench;
+	xml_bench_begin(&bench);
+
+	FILE*          f  = NULL;
+	xml_ostream_t* os = NULL;
+	if(mode == XML_BENCH_OSTREAM_NEW)
+	{
+		os = xml_ostream_new(fname);
+	}
+	else if(mode == XML_BENCH_OSTREAM_GZ)
+	{
+		os = xml_ostream_newGz(gzname);
+	}
+	else if(mode == XML_BENCH_OSTREAM_FILE)
+	{
+		f = fopen(tmpname, "w");
+		if(f == NULL)
+		{
+			LOGE("fopen %s failed", tmpname);
+			return 0;
+		}
+		os = xml_ostream_newFile(f);
+	}
+	else
+	{
+		os = xml_ostream_newBuffer();
+	}
+
+	if(os == NULL)
+	{
+		goto fail_os;
+	}
+
+	if(xml_bench_generate(os, &bench, corpus, size) == 0)
+	{
+		LOGE("generate %s failed", cname);
+		goto fail_generate;
+	}
+
+	// the buffer is measured without joining the chunks
+	size_t len = 0;
+	if(mode == XML_BENCH_OSTREAM_BUFFER)
+	{
+		int count;
+		xml_ostream_iovec(os, &count, &len);
+	}
+	xml_ostream_delete(&os);
+
+	if(f)
+	{
+		fclose(f);
+		f = NULL;
+	}
+
+	// the throughput is measured by the uncompressed bytes
+	// where the file mode corpus is written first
+	size_t bytes = len;
+	if(mode != XML_BENCH_OSTREAM_BUFFER)
+	{
+		bytes = xml_bench_size(fname);
+	}
+
+	xml_bench_report(&bench, cname,
+	                 XML_BENCH_OSTREAM_NAME[mode], bytes);
+	unlink(tmpname);
+
+	// success
+	return 1;
+
+	// failure
+	fail_generate:
+		xml_ostream_delete(&os);
+	fail_os:
+	{
+		if(f)
+		{
+			fclose(f);
+		}
+		unlink(tmpname);
+	}
+	return 0;
+}
+
+static int
+xml_bench_istream(const char* dir, int corpus, int type)
+{
+	ASSERT(dir);
+
+	const char* cname = XML_BENCH_CORPUS_NAME[corpus];
+	const char* name  = XML_BENCH_ISTREAM_NAME[type];
+
+	char fname[256];
+	char xname[256];
+	snprintf(fname, 256, "%s/%s%s", dir, cname,
+	         XML_BENCH_ISTREAM_SUFFIX[type]);
+	snprintf(xname, 256, "%s/%s.xml", dir, cname);
+
+	size_t bytes = xml_bench_size(xname);
+	if(xml_bench_size(fname) == 0)
+	{
+		// skip missing zstd and LZ4 input
+		return 1;
+	}
+
+	// the buffer is loaded before the measurement
+	char*  buffer = NULL;
+	FILE*  f      = NULL;
+	if((type == XML_BENCH_ISTREAM_BUFFER) ||
+	   (type == XML_BENCH_ISTREAM_SLICE)  ||
+	   (type == XML_BENCH_ISTREAM_FILE))
+	{
+		f = fopen(fname, "r");
+		if(f == NULL)
+		{
+			LOGE("fopen %s failed", fname);
+			return 0;
+		}
+	}
+
+	if(type != XML_BENCH_ISTREAM_FILE)
+	{
+		if(f)
+		{
+			buffer = (char*) malloc(bytes);
+			if((buffer == NULL) ||
+			   (fread(buffer, bytes, 1, f) != 1))
+			{
+				LOGE("read %s failed", fname);
+				goto fail_read;
+			}
+			fclose(f);
+			f = NULL;
+		}
+	}
+
+	xml_bench_t bench;
+	xml_bench_begin(&bench);
+
+	int ret;
+	void* priv = (void*) &bench;
+	if(type == XML_BENCH_ISTREAM_PARSE)
+	{
+		ret = xml_istream_parse(priv, xml_bench_start,
+		                        xml_bench_end, fname);
+	}
+	else if(type == XML_BENCH_ISTREAM_GZ)
+	{
+		ret = xml_istream_parseGz(priv, xml_bench_start,
+		                          xml_bench_end, fname);
+	}
+	else if(type == XML_BENCH_ISTREAM_ZSTD)
+	{
+		ret = xml_istream_parseZstd(priv, xml_bench_start,
+		                            xml_bench_end, fname);
+	}
+	else if(type == XML_BENCH_ISTREAM_LZ4)
+	{
+		ret = xml_istream_parseLz4(priv, xml_bench_start,
+		                           xml_bench_end, fname);
+	}
+	else if(type == XML_BENCH_ISTREAM_FILE)
+	{
+		ret = xml_istream_parseFile(priv, xml_bench_start,
+		                            xml_bench_end, f, bytes);
+	}
+	else if(type == XML_BENCH_ISTREAM_BUFFER)
+	{
+		ret = xml_istream_parseBuffer(priv, xml_bench_start,
+		                              xml_bench_end,
+		                              buffer, bytes);
+	}
+	else
+	{
+		ret = xml_istream_parseBufferSlice(priv,
+		                                   xml_bench_start,
+		                                   xml_bench_end,
+		                                   buffer, bytes,
+		                                   65536);
+	}
+
+	if(ret == 0)
+	{
+		LOGE("%s %s failed", name, fname);
+		goto fail_parse;
+	}
+
+	xml_bench_report(&bench, cname, name, bytes);
+
+	free(buffer);
+	if(f)
+	{
+		fclose(f);
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+	fail_read:
+	{
+		free(buffer);
+		if(f)
+		{
+			fclose(f);
+		}
+	}
+	return 0;
+}
+
+// measures the write throughput with the selected escape
+// kernel by writing values of len bytes as content in
+// documents of about 1 MB
+static int
+xml_bench_escape(int kernel, int escape, size_t len,
+                 size_t size)
+{
+	char* value = (char*) malloc(len);
+	if(value == NULL)
+	{
+		LOGE("malloc failed");
+		return 0;
+	}
+
+	uint32_t seed   = 1;
+	size_t   period = XML_BENCH_ESCAPE_PERIOD[escape];
+	size_t   i;
+	for(i = 0; i < len; ++i)
+	{
+		uint32_t r = xml_bench_rand(&seed)%32;
+		value[i] = (r < 6) ? ' ' : (char) ('a' + r%26);
+		if(period && ((i%period) == (period - 1)))
+		{
+			value[i] = "&<>\"'"[r%5];
+		}
+	}
+
+	xml_ostream_t* os = xml_ostream_newBuffer();
+	if(os == NULL)
+	{
+		goto fail_os;
+	}
+
+	size_t   bytes = 0;
+	double   t0    = xml_bench_time();
+	#ifdef XML_BENCH_CYCLES
+		uint64_t c0 = __rdtsc();
+	#endif
+	while(bytes < size)
+	{
+		size_t doc = 0;
+		xml_ostream_begin(os, "text");
+		while(doc < 1024*1024)
+		{
+			xml_ostream_begin(os, "v");
+			xml_ostream_contentn(os, value, len);
+			xml_ostream_end(os);
+			doc += len;
+		}
+		xml_ostream_end(os);
+
+		int    count;
+		size_t out;
+		if(xml_ostream_iovec(os, &count, &out) == NULL)
+		{
+			LOGE("escape failed");
+			goto fail_escape;
+		}
+		xml_ostream_reset(os);
+		bytes += doc;
+	}
+	double dt = xml_bench_time() - t0;
+
+	double mbs = ((double) bytes)/(1024.0*1024.0)/dt;
+	#ifdef XML_BENCH_CYCLES
+		uint64_t cycles = __rdtsc() - c0;
+		printf("%-6s %-6s %7lu %9.1f %8.3f\n",
+		       XML_BENCH_KERNEL_NAME[kernel],
+		       XML_BENCH_ESCAPE_NAME[escape],
+		       (unsigned long) len, mbs,
+		       ((double) bytes)/((double) cycles));
+	#else
+		printf("%-6s %-6s %7lu %9.1f %8s\n",
+		       XML_BENCH_KERNEL_NAME[kernel],
+		       XML_BENCH_ESCAPE_NAME[escape],
+		       (unsigned long) len, mbs, "n/a");
+	#endif
+	fflush(stdout);
+
+	xml_ostream_delete(&os);
+	free(value);
+
+	// success
+	return 1;
+
+	// failure
+	fail_escape:
+		xml_ostream_delete(&os);
+	fail_os:
+		free(value);
+	return 0;
+}
+
+// runs a case in a child process to measure its peak RSS
+static int
+xml_bench_fork(const char* dir, int corpus, int ostream,
+               int mode, size_t size)
+{
+	ASSERT(dir);
+
+	fflush(stdout);
+
+	pid_t pid = fork();
+	if(pid == -1)
+	{
+		LOGE("fork failed");
+		return 0;
+	}
+	else if(pid == 0)
+	{
+		int ret;
+		if(ostream)
+		{
+			ret = xml_bench_ostream(dir, corpus, mode, size);
+		}
+		else
+		{
+			ret = xml_bench_istream(dir, corpus, mode);
+		}
+		exit(ret ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	int status = 0;
+	if((waitpid(pid, &status, 0) == -1) ||
+	   (WIFEXITED(status) == 0) ||
+	   (WEXITSTATUS(status) != EXIT_SUCCESS))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+int main(int argc, char** argv)
+{
+	if((argc != 2) && (argc != 3))
+	{
+		LOGE("usage: %s <dir> [MB]", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char* dir  = argv[1];
+	size_t      size = 16;
+	if(argc == 3)
+	{
+		size = (size_t) strtol(argv[2], NULL, 10);
+	}
+	size *= 1024*1024;
+
+	// ostream cases write the corpora which are then parsed
+	// by the istream cases
+	printf("%-5s %-29s %9s %12s %10s %9s\n",
+	       "data", "case", "MB/s", "events/s", "allocs/ev",
+	       "RSS(KB)");
+
+	int ret = EXIT_SUCCESS;
+	int corpus;
+	int mode;
+	for(corpus = 0; corpus < XML_BENCH_CORPUS_COUNT; ++corpus)
+	{
+		for(mode = 0; mode < XML_BENCH_OSTREAM_COUNT; ++mode)
+		{
+			if(xml_bench_fork(dir, corpus, 1, mode,
+			                  size) == 0)
+			{
+				ret = EXIT_FAILURE;
+			}
+		}
+
+		for(mode = 0; mode < XML_BENCH_ISTREAM_COUNT; ++mode)
+		{
+			if(xml_bench_fork(dir, corpus, 0, mode,
+			                  size) == 0)
+			{
+				ret = EXIT_FAILURE;
+			}
+		}
+	}
+
+	// escape kernels where the cycles are measured by the
+	// time stamp counter on x86 and the rates include the
+	// whole write path (begin/contentn/end, iovec and reset)
+	// rather than the escape scan alone
+	printf("\n%-6s %-6s %7s %9s %8s\n",
+	       "kernel", "data", "len", "MB/s", "B/cycle");
+
+	int kernel;
+	int escape;
+	for(kernel = 0; kernel < XML_BENCH_KERNEL_COUNT; ++kernel)
+	{
+		// skip unsupported kernels
+		int k = XML_BENCH_KERNEL[kernel];
+		if(xml_ostream_kernelSupported(k) == 0)
+		{
+			continue;
+		}
+		xml_ostream_kernel(k);
+
+		for(escape = 0; escape < XML_BENCH_ESCAPE_COUNT; ++escape)
+		{
+			if((xml_bench_escape(kernel, escape, 32,
+			                     size) == 0) ||
+			   (xml_bench_escape(kernel, escape, 65536,
+			                     size) == 0))
+			{
+				ret = EXIT_FAILURE;
+			}
+		}
+	}
+	xml_ostream_kernel(XML_OSTREAM_KERNEL_AUTO);
+
+	return ret;
+}
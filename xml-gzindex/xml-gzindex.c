@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+
+#define LOG_TAG "xml-gzindex"
+#include "libcc/cc_log.h"
+#include "libxmlstream/xml_gzindex.h"
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+int main(int argc, char** argv)
+{
+	if(argc != 5)
+	{
+		LOGE("usage: %s <record> <span-MB> <in.xml.gz> <out.idx>",
+		     argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int64_t span = (int64_t) strtol(argv[2], NULL, 10);
+	span *= 1024*1024;
+
+	xml_gzindex_t* index;
+	index = xml_gzindex_build(argv[3], argv[1], span);
+	if(index == NULL)
+	{
+		LOGE("xml_gzindex_build failed");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("len=%lli, points=%i, entries=%i, root=%s",
+	     (long long) index->len, index->points_count,
+	     index->entries_count, index->root);
+
+	if(xml_gzindex_save(index, argv[4]) == 0)
+	{
+		LOGE("xml_gzindex_save failed");
+		xml_gzindex_delete(&index);
+		return EXIT_FAILURE;
+	}
+
+	xml_gzindex_delete(&index);
+
+	return EXIT_SUCCESS;
+}
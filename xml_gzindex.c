@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "xml"
+#include "../libcc/cc_log.h"
+#include "../libcc/cc_memory.h"
+#include "xml_gzindex.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+// size of the reads while building the index where the
+// span must exceed the buffer so that each read captures
+// at most one access point
+#define XML_GZINDEX_BUFFER 65536
+
+// index file header which is followed by the access points
+// (without the unused window bytes) and the entries
+#define XML_GZINDEX_MAGIC "XMLGZIX1"
+
+typedef struct
+{
+	char    magic[8];
+	char    record[256];
+	char    root[256];
+	int64_t len;
+	int64_t tail;
+	int     tail_line;
+	int     points_count;
+	int     entries_count;
+} xml_gzindexHeader_t;
+
+static int
+xml_gzindex_addPoint(xml_gzindex_t* self,
+                     const xml_inflatePoint_t* point)
+{
+	ASSERT(self);
+	ASSERT(point);
+
+	if(self->points_count == self->points_size)
+	{
+		int size = self->points_size ? 2*self->points_size : 16;
+
+		xml_inflatePoint_t* points;
+		points = (xml_inflatePoint_t*)
+		         REALLOC(self->points,
+		                 size*sizeof(xml_inflatePoint_t));
+		if(points == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->points      = points;
+		self->points_size = size;
+	}
+
+	self->points[self->points_count++] = *point;
+	return 1;
+}
+
+static int
+xml_gzindex_addEntry(xml_gzindex_t* self,
+                     int64_t out, int line, int point)
+{
+	ASSERT(self);
+
+	if(self->entries_count == self->entries_size)
+	{
+		int size = self->entries_size ? 2*self->entries_size : 64;
+
+		xml_gzindexEntry_t* entries;
+		entries = (xml_gzindexEntry_t*)
+		          REALLOC(self->entries,
+		                  size*sizeof(xml_gzindexEntry_t));
+		if(entries == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->entries      = entries;
+		self->entries_size = size;
+	}
+
+	xml_gzindexEntry_t* entry;
+	entry = &self->entries[self->entries_count++];
+	entry->out   = out;
+	entry->line  = line;
+	entry->point = point;
+	return 1;
+}
+
+static int
+xml_gzindex_countLines(const char* buf, size_t* _lpos,
+                       size_t pos, int line)
+{
+	ASSERT(buf);
+	ASSERT(_lpos);
+
+	// count the newlines between lpos and pos
+	const char* p   = &buf[*_lpos];
+	const char* end = &buf[pos];
+	while(p < end)
+	{
+		p = (const char*) memchr(p, '\n', end - p);
+		if(p == NULL)
+		{
+			break;
+		}
+		++line;
+		++p;
+	}
+	*_lpos = pos;
+
+	return line;
+}
+
+static int
+xml_gzindex_root(xml_gzindex_t* self,
+                 xml_inflate_t* inflate)
+{
+	ASSERT(self);
+	ASSERT(inflate);
+
+	// read the root name from the closing root tag
+	const xml_inflatePoint_t* point;
+	point = xml_gzindex_point(self, self->tail);
+	if((point == NULL) ||
+	   (xml_inflate_seek(inflate, point, self->tail) == 0))
+	{
+		return 0;
+	}
+
+	char buf[258];
+	int  bytes = xml_inflate_read(inflate, buf, 258);
+	if(bytes < 3)
+	{
+		LOGE("invalid tail=%lli", (long long) self->tail);
+		return 0;
+	}
+
+	int i = 2;
+	while((i < bytes) && (buf[i] != '>') && (buf[i] != ' ') &&
+	      (buf[i] != '\t') && (buf[i] != '\r') &&
+	      (buf[i] != '\n'))
+	{
+		++i;
+	}
+
+	if((i == 2) || (i == bytes))
+	{
+		LOGE("invalid tail=%lli", (long long) self->tail);
+		return 0;
+	}
+
+	snprintf(self->root, 256, "%.*s", i - 2, &buf[2]);
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+xml_gzindex_t* xml_gzindex_build(const char* gzname,
+                                 const char* record,
+                                 int64_t span)
+{
+	ASSERT(gzname);
+	ASSERT(record);
+
+	size_t rlen = strlen(record);
+	if((rlen == 0) || (rlen >= 256) ||
+	   (span <= XML_GZINDEX_BUFFER))
+	{
+		LOGE("invalid record=%s, span=%lli",
+		     record, (long long) span);
+		return NULL;
+	}
+
+	xml_gzindex_t* self = (xml_gzindex_t*)
+	                      CALLOC(1, sizeof(xml_gzindex_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+	snprintf(self->record, 256, "%s", record);
+
+	xml_inflate_t* inflate = xml_inflate_new(gzname);
+	if(inflate == NULL)
+	{
+		goto fail_inflate;
+	}
+	xml_inflate_span(inflate, span);
+
+	// the buffer keeps the bytes after the last unclassified
+	// '<' from the previous read
+	char* buf = (char*) MALLOC(2*XML_GZINDEX_BUFFER);
+	if(buf == NULL)
+	{
+		LOGE("MALLOC failed");
+		goto fail_buf;
+	}
+
+	int64_t base    = 0;
+	size_t  have    = 0;
+	size_t  lpos    = 0;
+	int     line    = 1;
+	int     points  = 0;
+	int     pending = 0;
+	int     eof     = 0;
+	self->tail      = -1;
+	while(eof == 0)
+	{
+		int bytes = xml_inflate_read(inflate, &buf[have],
+		                             XML_GZINDEX_BUFFER);
+		if(bytes < 0)
+		{
+			goto fail_read;
+		}
+		eof   = (bytes == 0) ? 1 : 0;
+		have += bytes;
+
+		// the next record after a new access point is indexed
+		if(inflate->point_count != points)
+		{
+			if(xml_gzindex_addPoint(self, &inflate->point) == 0)
+			{
+				goto fail_read;
+			}
+			points  = inflate->point_count;
+			pending = 1;
+		}
+
+		size_t i = 0;
+		while(i < have)
+		{
+			const char* p;
+			p = (const char*) memchr(&buf[i], '<', have - i);
+			if(p == NULL)
+			{
+				i = have;
+				break;
+			}
+
+			i = (size_t) (p - buf);
+			if((eof == 0) && ((i + rlen + 2) > have))
+			{
+				break;
+			}
+
+			if(((i + 1) < have) && (buf[i + 1] == '/'))
+			{
+				self->tail      = base + i;
+				self->tail_line = line =
+					xml_gzindex_countLines(buf, &lpos, i, line);
+			}
+			else if(pending &&
+			        ((base + (int64_t) i) >=
+			         self->points[self->points_count - 1].out) &&
+			        ((i + rlen + 1) < have) &&
+			        (memcmp(&buf[i + 1], record, rlen) == 0))
+			{
+				char c = buf[i + rlen + 1];
+				if((c == ' ')  || (c == '\t') || (c == '\n') ||
+				   (c == '\r') || (c == '/')  || (c == '>'))
+				{
+					line = xml_gzindex_countLines(buf, &lpos, i,
+					                              line);
+					if(xml_gzindex_addEntry(self, base + i, line,
+					                        self->points_count - 1) == 0)
+					{
+						goto fail_read;
+					}
+					pending = 0;
+				}
+			}
+			++i;
+		}
+
+		// keep the unclassified bytes for the next read
+		line  = xml_gzindex_countLines(buf, &lpos, i, line);
+		memmove(buf, &buf[i], have - i);
+		base += i;
+		have -= i;
+		lpos  = 0;
+	}
+	self->len = inflate->out;
+
+	if((self->entries_count == 0) ||
+	   (self->tail <= self->entries[self->entries_count - 1].out))
+	{
+		LOGE("invalid record=%s", record);
+		goto fail_read;
+	}
+
+	if(xml_gzindex_root(self, inflate) == 0)
+	{
+		goto fail_read;
+	}
+
+	FREE(buf);
+	xml_inflate_delete(&inflate);
+
+	// success
+	return self;
+
+	// failure
+	fail_read:
+		FREE(buf);
+	fail_buf:
+		xml_inflate_delete(&inflate);
+	fail_inflate:
+		xml_gzindex_delete(&self);
+	return NULL;
+}
+
+xml_gzindex_t* xml_gzindex_load(const char* fname)
+{
+	ASSERT(fname);
+
+	FILE* f = fopen(fname, "r");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", fname);
+		return NULL;
+	}
+
+	xml_gzindexHeader_t header;
+	if((fread(&header, sizeof(xml_gzindexHeader_t), 1,
+	          f) != 1) ||
+	   (memcmp(header.magic, XML_GZINDEX_MAGIC, 8) != 0) ||
+	   (header.points_count < 1) ||
+	   (header.entries_count < 1))
+	{
+		LOGE("invalid %s", fname);
+		goto fail_header;
+	}
+
+	xml_gzindex_t* self = (xml_gzindex_t*)
+	                      CALLOC(1, sizeof(xml_gzindex_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_alloc;
+	}
+
+	memcpy(self->record, header.record, 256);
+	memcpy(self->root, header.root, 256);
+	self->record[255] = '\0';
+	self->root[255]   = '\0';
+	self->len         = header.len;
+	self->tail        = header.tail;
+	self->tail_line   = header.tail_line;
+
+	self->points = (xml_inflatePoint_t*)
+	               CALLOC(header.points_count,
+	                      sizeof(xml_inflatePoint_t));
+	self->entries = (xml_gzindexEntry_t*)
+	                CALLOC(header.entries_count,
+	                       sizeof(xml_gzindexEntry_t));
+	if((self->points == NULL) || (self->entries == NULL))
+	{
+		LOGE("CALLOC failed");
+		goto fail_read;
+	}
+	self->points_size  = header.points_count;
+	self->entries_size = header.entries_count;
+
+	int i;
+	size_t size = offsetof(xml_inflatePoint_t, window);
+	for(i = 0; i < header.points_count; ++i)
+	{
+		xml_inflatePoint_t* point = &self->points[i];
+		if((fread(point, size, 1, f) != 1) ||
+		   (point->window_len > XML_INFLATE_WINDOW) ||
+		   (point->window_len &&
+		    (fread(point->window, point->window_len, 1,
+		           f) != 1)))
+		{
+			LOGE("invalid %s", fname);
+			goto fail_read;
+		}
+		self->points_count = i + 1;
+	}
+
+	if(fread(self->entries, sizeof(xml_gzindexEntry_t),
+	         header.entries_count,
+	         f) != (size_t) header.entries_count)
+	{
+		LOGE("invalid %s", fname);
+		goto fail_read;
+	}
+	self->entries_count = header.entries_count;
+
+	for(i = 0; i < self->entries_count; ++i)
+	{
+		int point = self->entries[i].point;
+		if((point < 0) || (point >= self->points_count))
+		{
+			LOGE("invalid %s", fname);
+			goto fail_read;
+		}
+	}
+	fclose(f);
+
+	// success
+	return self;
+
+	// failure
+	fail_read:
+		xml_gzindex_delete(&self);
+	fail_alloc:
+	fail_header:
+		fclose(f);
+	return NULL;
+}
+
+void xml_gzindex_delete(xml_gzindex_t** _self)
+{
+	ASSERT(_self);
+
+	xml_gzindex_t* self = *_self;
+	if(self)
+	{
+		FREE(self->points);
+		FREE(self->entries);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int xml_gzindex_save(const xml_gzindex_t* self,
+                     const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	xml_gzindexHeader_t header;
+	memset(&header, 0, sizeof(xml_gzindexHeader_t));
+	memcpy(header.magic, XML_GZINDEX_MAGIC, 8);
+	memcpy(header.record, self->record, 256);
+	memcpy(header.root, self->root, 256);
+	header.len           = self->len;
+	header.tail          = self->tail;
+	header.tail_line     = self->tail_line;
+	header.points_count  = self->points_count;
+	header.entries_count = self->entries_count;
+
+	FILE* f = fopen(fname, "w");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", fname);
+		return 0;
+	}
+
+	if(fwrite(&header, sizeof(xml_gzindexHeader_t), 1, f) != 1)
+	{
+		goto fail_write;
+	}
+
+	int i;
+	size_t size = offsetof(xml_inflatePoint_t, window);
+	for(i = 0; i < self->points_count; ++i)
+	{
+		const xml_inflatePoint_t* point = &self->points[i];
+		if((fwrite(point, size, 1, f) != 1) ||
+		   (point->window_len &&
+		    (fwrite(point->window, point->window_len, 1,
+		            f) != 1)))
+		{
+			goto fail_write;
+		}
+	}
+
+	if(fwrite(self->entries, sizeof(xml_gzindexEntry_t),
+	          self->entries_count,
+	          f) != (size_t) self->entries_count)
+	{
+		goto fail_write;
+	}
+
+	if(fclose(f) != 0)
+	{
+		LOGE("fclose %s failed", fname);
+		return 0;
+	}
+
+	// success
+	return 1;
+
+	// failure
+	fail_write:
+		LOGE("fwrite %s failed", fname);
+		fclose(f);
+	return 0;
+}
+
+const xml_inflatePoint_t*
+xml_gzindex_point(const xml_gzindex_t* self, int64_t out)
+{
+	ASSERT(self);
+
+	// binary search for the last point at or before out
+	int lo = 0;
+	int hi = self->points_count;
+	while(lo < hi)
+	{
+		int mid = lo + (hi - lo)/2;
+		if(self->points[mid].out <= out)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return (lo == 0) ? NULL : &self->points[lo - 1];
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xml_gzindex_H
+#define xml_gzindex_H
+
+#include <stdint.h>
+#include "xml_inflate.h"
+
+// an entry is the first record which starts after an
+// access point
+typedef struct
+{
+	int64_t out;
+	int     line;
+	int     point;
+} xml_gzindexEntry_t;
+
+// the gzip index stores the access points of a file and the
+// record boundaries of sibling elements named record which
+// are children of the root element (records must not
+// appear in comments or CDATA)
+// tail is the offset of the closing root tag
+typedef struct
+{
+	char    record[256];
+	char    root[256];
+	int64_t len;
+	int64_t tail;
+	int     tail_line;
+
+	xml_inflatePoint_t* points;
+	int                 points_count;
+	int                 points_size;
+
+	xml_gzindexEntry_t* entries;
+	int                 entries_count;
+	int                 entries_size;
+} xml_gzindex_t;
+
+// build decodes the file once and captures an access point
+// every span uncompressed bytes
+xml_gzindex_t* xml_gzindex_build(const char* gzname,
+                                 const char* record,
+                                 int64_t span);
+xml_gzindex_t* xml_gzindex_load(const char* fname);
+void           xml_gzindex_delete(xml_gzindex_t** _self);
+int            xml_gzindex_save(const xml_gzindex_t* self,
+                                const char* fname);
+
+// returns the last access point at or before out
+const xml_inflatePoint_t*
+               xml_gzindex_point(const xml_gzindex_t* self,
+                                 int64_t out);
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define LOG_TAG "xml"
+#include "../libcc/cc_log.h"
+#include "../libcc/cc_memory.h"
+#include "xml_inflate.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static void
+xml_inflate_capture(xml_inflate_t* self, int64_t out)
+{
+	ASSERT(self);
+
+	// the access point must be at a block boundary which is
+	// not the end of the last block
+	int type = self->strm.data_type;
+	if((self->span == 0) || ((type & 128) == 0) ||
+	   (type & 64))
+	{
+		return;
+	}
+
+	if(self->point_count &&
+	   ((out - self->point.out) < self->span))
+	{
+		return;
+	}
+
+	xml_inflatePoint_t* point = &self->point;
+	point->in         = self->in - self->strm.avail_in;
+	point->bits       = type & 7;
+	point->out        = out;
+	point->window_len = XML_INFLATE_WINDOW;
+	if(inflateGetDictionary(&self->strm, point->window,
+	                        &point->window_len) != Z_OK)
+	{
+		point->window_len = 0;
+	}
+	++self->point_count;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+xml_inflate_t* xml_inflate_new(const char* gzname)
+{
+	ASSERT(gzname);
+
+	xml_inflate_t* self = (xml_inflate_t*)
+	                      CALLOC(1, sizeof(xml_inflate_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->f = fopen(gzname, "rb");
+	if(self->f == NULL)
+	{
+		LOGE("fopen %s failed", gzname);
+		goto fail_fopen;
+	}
+
+	// decode the gzip header
+	if(inflateInit2(&self->strm, 15 + 16) != Z_OK)
+	{
+		LOGE("inflateInit2 failed");
+		goto fail_inflate;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_inflate:
+		fclose(self->f);
+	fail_fopen:
+		FREE(self);
+	return NULL;
+}
+
+void xml_inflate_delete(xml_inflate_t** _self)
+{
+	ASSERT(_self);
+
+	xml_inflate_t* self = *_self;
+	if(self)
+	{
+		inflateEnd(&self->strm);
+		fclose(self->f);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void xml_inflate_span(xml_inflate_t* self, int64_t span)
+{
+	ASSERT(self);
+
+	self->span = span;
+}
+
+int xml_inflate_seek(xml_inflate_t* self,
+                     const xml_inflatePoint_t* point,
+                     int64_t out)
+{
+	ASSERT(self);
+	ASSERT(point);
+
+	if((out < point->out) || (point->bits < 0) ||
+	   (point->bits > 7) ||
+	   (point->window_len > XML_INFLATE_WINDOW))
+	{
+		LOGE("invalid out=%lli, bits=%i",
+		     (long long) out, point->bits);
+		return 0;
+	}
+
+	// restart with a raw deflate stream at the access point
+	// which may begin with the bits of the previous byte
+	if(inflateReset2(&self->strm, -15) != Z_OK)
+	{
+		LOGE("inflateReset2 failed");
+		return 0;
+	}
+
+	int64_t in = point->in - (point->bits ? 1 : 0);
+	if(fseeko(self->f, (off_t) in, SEEK_SET) == -1)
+	{
+		LOGE("fseeko failed");
+		return 0;
+	}
+
+	self->strm.next_in  = self->input;
+	self->strm.avail_in = 0;
+	self->member        = 1;
+	self->raw           = 1;
+	self->skip          = 0;
+	self->eof           = 0;
+	self->in            = in;
+	self->out           = point->out;
+
+	if(point->bits)
+	{
+		int c = getc(self->f);
+		if(c == EOF)
+		{
+			LOGE("getc failed");
+			return 0;
+		}
+		++self->in;
+		inflatePrime(&self->strm, point->bits,
+		             c >> (8 - point->bits));
+	}
+
+	if(point->window_len &&
+	   (inflateSetDictionary(&self->strm, point->window,
+	                         point->window_len) != Z_OK))
+	{
+		LOGE("inflateSetDictionary failed");
+		return 0;
+	}
+
+	// discard the bytes before out
+	unsigned char buf[4096];
+	while(self->out < out)
+	{
+		int64_t left  = out - self->out;
+		int     bytes = (int) ((left > 4096) ? 4096 : left);
+		bytes = xml_inflate_read(self, buf, bytes);
+		if(bytes <= 0)
+		{
+			LOGE("invalid out=%lli", (long long) out);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int xml_inflate_read(xml_inflate_t* self,
+                     void* buf, int size)
+{
+	ASSERT(self);
+	ASSERT(buf);
+
+	z_stream* strm = &self->strm;
+	strm->next_out  = (Bytef*) buf;
+	strm->avail_out = (uInt) size;
+	while((strm->avail_out > 0) && (self->eof == 0))
+	{
+		if(strm->avail_in == 0)
+		{
+			size_t bytes = fread(self->input, 1,
+			                     XML_INFLATE_INPUT, self->f);
+			if(ferror(self->f))
+			{
+				LOGE("fread failed");
+				return -1;
+			}
+			else if(bytes == 0)
+			{
+				// the file may only end between members
+				if(self->member || self->skip)
+				{
+					LOGE("truncated in=%lli",
+					     (long long) self->in);
+					return -1;
+				}
+				self->eof = 1;
+				break;
+			}
+			self->in      += bytes;
+			strm->next_in  = self->input;
+			strm->avail_in = (uInt) bytes;
+		}
+
+		// skip the trailer of a raw member
+		if(self->skip)
+		{
+			uInt skip = ((uInt) self->skip < strm->avail_in) ?
+			            (uInt) self->skip : strm->avail_in;
+			strm->next_in  += skip;
+			strm->avail_in -= skip;
+			self->skip     -= (int) skip;
+			continue;
+		}
+
+		// start the next member or ignore trailing padding
+		if(self->member == 0)
+		{
+			if(strm->next_in[0] != 0x1F)
+			{
+				if(self->in == (int64_t) strm->avail_in)
+				{
+					LOGE("invalid gzip");
+					return -1;
+				}
+				self->eof = 1;
+				break;
+			}
+
+			if(inflateReset2(strm, 15 + 16) != Z_OK)
+			{
+				LOGE("inflateReset2 failed");
+				return -1;
+			}
+			self->member = 1;
+			self->raw    = 0;
+		}
+
+		int ret = inflate(strm, Z_BLOCK);
+		if((ret == Z_NEED_DICT) || (ret == Z_DATA_ERROR) ||
+		   (ret == Z_MEM_ERROR) || (ret == Z_STREAM_ERROR))
+		{
+			LOGE("inflate failed ret=%i, in=%lli",
+			     ret, (long long) self->in);
+			return -1;
+		}
+		else if(ret == Z_STREAM_END)
+		{
+			// the gzip trailer is not consumed in raw mode
+			self->member = 0;
+			if(self->raw)
+			{
+				self->skip = 8;
+			}
+		}
+		else
+		{
+			xml_inflate_capture(self, self->out +
+			                          (size - strm->avail_out));
+		}
+	}
+
+	int bytes  = size - (int) strm->avail_out;
+	self->out += bytes;
+	return bytes;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xml_inflate_H
+#define xml_inflate_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <zlib.h>
+
+#define XML_INFLATE_WINDOW 32768
+#define XML_INFLATE_INPUT  65536
+
+// an access point at a deflate block boundary where
+// inflate may be restarted with the preceding window
+typedef struct
+{
+	// compressed offset of the next byte and the number of
+	// bits (0-7) of the previous byte which remain
+	int64_t in;
+	int     bits;
+
+	// uncompressed offset
+	int64_t out;
+
+	unsigned int  window_len;
+	unsigned char window[XML_INFLATE_WINDOW];
+} xml_inflatePoint_t;
+
+// the inflate reader decodes single and multi-member gzip
+// files and captures the latest access point every span
+// uncompressed bytes (span=0 disables access points)
+typedef struct
+{
+	FILE*    f;
+	z_stream strm;
+
+	// member is set while inside of a gzip member, raw is
+	// set after a seek until the end of the deflate stream
+	// and skip is the number of trailer bytes remaining
+	int member;
+	int raw;
+	int skip;
+	int eof;
+
+	// compressed bytes read and uncompressed bytes returned
+	int64_t in;
+	int64_t out;
+
+	int64_t            span;
+	int                point_count;
+	xml_inflatePoint_t point;
+
+	unsigned char input[XML_INFLATE_INPUT];
+} xml_inflate_t;
+
+xml_inflate_t* xml_inflate_new(const char* gzname);
+void           xml_inflate_delete(xml_inflate_t** _self);
+void           xml_inflate_span(xml_inflate_t* self,
+                                int64_t span);
+
+// restarts inflate at the access point and discards the
+// uncompressed bytes up to out
+int            xml_inflate_seek(xml_inflate_t* self,
+                                const xml_inflatePoint_t* point,
+                                int64_t out);
+
+// returns the number of bytes read, 0 at the end of the
+// file or -1 when an error occurs
+int            xml_inflate_read(xml_inflate_t* self,
+                                void* buf, int size);
+
+#endif
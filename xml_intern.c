@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "xml"
+#include "../libcc/cc_log.h"
+#include "../libcc/cc_memory.h"
+#include "xml_intern.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int xml_intern_hash(const char* name)
+{
+	ASSERT(name);
+
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	while(name[0] != '\0')
+	{
+		hash ^= (unsigned char) name[0];
+		hash *= 16777619u;
+		++name;
+	}
+
+	return (int) (hash & 0x7FFFFFFF);
+}
+
+static int xml_intern_rehash(xml_intern_t* self, int size)
+{
+	ASSERT(self);
+
+	int* slots = (int*) MALLOC(size*sizeof(int));
+	if(slots == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+
+	int i;
+	for(i = 0; i < size; ++i)
+	{
+		slots[i] = -1;
+	}
+
+	// size is a power of two
+	int mask = size - 1;
+	for(i = 0; i < self->count; ++i)
+	{
+		int j = self->hashes[i] & mask;
+		while(slots[j] != -1)
+		{
+			j = (j + 1) & mask;
+		}
+		slots[j] = i;
+	}
+
+	FREE(self->slots);
+	self->slots      = slots;
+	self->slots_size = size;
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+xml_intern_t* xml_intern_new(void)
+{
+	xml_intern_t* self = (xml_intern_t*)
+	                     CALLOC(1, sizeof(xml_intern_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	if(xml_intern_rehash(self, 64) == 0)
+	{
+		goto fail_rehash;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_rehash:
+		FREE(self);
+	return NULL;
+}
+
+void xml_intern_delete(xml_intern_t** _self)
+{
+	ASSERT(_self);
+
+	xml_intern_t* self = *_self;
+	if(self)
+	{
+		FREE(self->slots);
+		FREE(self->hashes);
+		FREE(self->names);
+		FREE(self->arena);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int xml_intern_add(xml_intern_t* self, const char* name)
+{
+	ASSERT(self);
+	ASSERT(name);
+
+	int id = xml_intern_find(self, name);
+	if(id >= 0)
+	{
+		return id;
+	}
+
+	// keep the load factor below 1/2
+	if(2*(self->count + 1) > self->slots_size)
+	{
+		if(xml_intern_rehash(self, 2*self->slots_size) == 0)
+		{
+			return -1;
+		}
+	}
+
+	if(self->count == self->size)
+	{
+		int size = self->size ? 2*self->size : 64;
+
+		size_t* names = (size_t*)
+		                REALLOC(self->names, size*sizeof(size_t));
+		if(names == NULL)
+		{
+			LOGE("REALLOC failed");
+			return -1;
+		}
+		self->names = names;
+
+		int* hashes = (int*)
+		              REALLOC(self->hashes, size*sizeof(int));
+		if(hashes == NULL)
+		{
+			LOGE("REALLOC failed");
+			return -1;
+		}
+		self->hashes = hashes;
+		self->size   = size;
+	}
+
+	size_t len = strlen(name) + 1;
+	if(self->arena_len + len > self->arena_size)
+	{
+		size_t size = self->arena_size ? self->arena_size : 1024;
+		while(size < self->arena_len + len)
+		{
+			size *= 2;
+		}
+
+		char* arena = (char*) REALLOC(self->arena, size);
+		if(arena == NULL)
+		{
+			LOGE("REALLOC failed");
+			return -1;
+		}
+		self->arena      = arena;
+		self->arena_size = size;
+	}
+
+	id = self->count;
+	memcpy(&self->arena[self->arena_len], name, len);
+	self->names[id]  = self->arena_len;
+	self->hashes[id] = xml_intern_hash(name);
+	self->arena_len += len;
+	++self->count;
+
+	int mask = self->slots_size - 1;
+	int j    = self->hashes[id] & mask;
+	while(self->slots[j] != -1)
+	{
+		j = (j + 1) & mask;
+	}
+	self->slots[j] = id;
+
+	return id;
+}
+
+int xml_intern_find(const xml_intern_t* self,
+                    const char* name)
+{
+	ASSERT(self);
+	ASSERT(name);
+
+	int hash = xml_intern_hash(name);
+	int mask = self->slots_size - 1;
+	int j    = hash & mask;
+	while(self->slots[j] != -1)
+	{
+		int id = self->slots[j];
+		if((self->hashes[id] == hash) &&
+		   (strcmp(&self->arena[self->names[id]], name) == 0))
+		{
+			return id;
+		}
+		j = (j + 1) & mask;
+	}
+
+	return -1;
+}
+
+const char* xml_intern_name(const xml_intern_t* self, int id)
+{
+	ASSERT(self);
+
+	if((id < 0) || (id >= self->count))
+	{
+		return NULL;
+	}
+
+	return &self->arena[self->names[id]];
+}
+
+int xml_intern_count(const xml_intern_t* self)
+{
+	ASSERT(self);
+
+	return self->count;
+}
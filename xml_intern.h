@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xml_intern_H
+#define xml_intern_H
+
+#include <stddef.h>
+
+// the intern table maps element and attribute names to
+// small integer ids which are assigned in the order that
+// names are added (starting at 0)
+// find and name are read-only and may be called from many
+// threads as long as no names are added concurrently
+typedef struct
+{
+	// names are stored in the arena at offsets
+	char*   arena;
+	size_t  arena_len;
+	size_t  arena_size;
+	size_t* names;
+	int*    hashes;
+	int     count;
+	int     size;
+
+	// open addressing hash table of ids (-1 when empty)
+	int* slots;
+	int  slots_size;
+} xml_intern_t;
+
+xml_intern_t* xml_intern_new(void);
+void          xml_intern_delete(xml_intern_t** _self);
+int           xml_intern_add(xml_intern_t* self,
+                             const char* name);
+int           xml_intern_find(const xml_intern_t* self,
+                              const char* name);
+const char*   xml_intern_name(const xml_intern_t* self,
+                              int id);
+int           xml_intern_count(const xml_intern_t* self);
+
+#endif
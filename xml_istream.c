@@ -21,10 +21,28 @@
  *
  */
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <zlib.h>
 
+#ifdef XML_ISTREAM_ZSTD
+	#include <zstd.h>
+#endif
+
+#ifdef XML_ISTREAM_LZ4
+	#include <lz4frame.h>
+#endif
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
 #define LOG_TAG "xml"
 #include "../libcc/cc_log.h"
 #include "../libcc/cc_memory.h"
@@ -34,258 +52,6404 @@
 * private                                                  *
 ***********************************************************/
 
+// size of the slices passed to XML_Parse for mapped files
+// which also determines the progress update granularity
+#define XML_ISTREAM_MMAP_SLICE 65536
+
+// input formats detected by their magic bytes
+#define XML_ISTREAM_FORMAT_XML  0
+#define XML_ISTREAM_FORMAT_GZ   1
+#define XML_ISTREAM_FORMAT_ZSTD 2
+#define XML_ISTREAM_FORMAT_LZ4  3
+
+// event log record types for parallel and batched events
+#define XML_ISTREAM_RECORD_START 0
+#define XML_ISTREAM_RECORD_END   1
+
 typedef struct
 {
-	int error;
+	int    type;
+	int    id;
+	int    depth;
+	int    line;
+	size_t name;
+	size_t atts;
+	int    natts;
+	size_t content;
+	size_t len;
+} xml_istreamRecord_t;
 
-	float progress;
+// events recorded by a worker for an ordered chunk or for
+// a batch where strings are stored as offsets into the arena
+typedef struct
+{
+	char*  arena;
+	size_t arena_len;
+	size_t arena_size;
 
-	// callbacks
-	void* priv;
-	xml_istream_start_fn start_fn;
-	xml_istream_end_fn   end_fn;
+	xml_istreamRecord_t* records;
+	int                  records_count;
+	int                  records_size;
 
-	// buffered content
-	char* content_buf;
-	int   content_len;
+	size_t* atts;
+	int     atts_count;
+	int     atts_size;
+} xml_istreamLog_t;
 
-	// Expat parser
-	XML_Parser parser;
-} xml_istream_t;
+// batched events are recorded in the log until count events
+// are delivered at once where the events and atts arrays are
+// rebuilt from the log
+typedef struct xml_istreamBatch_s
+{
+	xml_istream_batch_fn batch_fn;
+	int                  count;
+	int                  lines;
+	xml_istreamLog_t     log;
+	xml_istreamEvent_t*  events;
+	const char**         atts;
+	int                  atts_size;
+} xml_istreamBatch_t;
 
-static void xml_istream_start(void* _self,
-                              const XML_Char* name,
-                              const XML_Char** atts)
+typedef struct
 {
-	ASSERT(_self);
+	char                name[256];
+	xml_istream_tree_fn tree_fn;
+} xml_istreamTreeName_t;
+
+// tree nodes in document order where strings are stored as
+// offsets into the log arena until the tree is delivered
+typedef struct
+{
+	int    parent;
+	int    next;
+	int    count;
+	int    line;
+	size_t name;
+	size_t atts;
+	int    natts;
+	size_t content;
+	size_t len;
+} xml_istreamTreeNode_t;
+
+// the open nodes and their last child for each level
+typedef struct
+{
+	int node;
+	int last;
+} xml_istreamTreeLevel_t;
+
+// the subtree of a materialized element is recorded while
+// depth is set where the arena is reset after each tree
+// and the nodes/atts arrays are rebuilt from the log
+typedef struct xml_istreamTree_s
+{
+	xml_istreamTreeName_t* names;
+	int                    names_count;
+
+	xml_istream_tree_fn tree_fn;
+	int                 depth;
+	xml_istreamLog_t    log;
+
+	xml_istreamTreeNode_t* nodes;
+	int                    nodes_count;
+	int                    nodes_size;
+
+	xml_istreamTreeLevel_t* levels;
+	int                     levels_size;
+
+	xml_istreamNode_t* out;
+	int                out_size;
+	const char**       atts;
+	int                atts_size;
+} xml_istreamTree_t;
+
+// attribute spans of the current start tag
+typedef struct
+{
+	size_t name;
+	size_t name_len;
+	size_t value;
+	size_t value_len;
+} xml_istreamScanAttr_t;
+
+// the structural scanner reports the line and the offset
+// after the current tag while active where the names and
+// decoded values of a start tag are stored in buf
+typedef struct xml_istreamScan_s
+{
+	int     active;
+	int     line;
+	int64_t offset;
+
+	char*  buf;
+	size_t buf_size;
+
+	xml_istreamScanAttr_t* attrs;
+	int                    attrs_size;
+	const char**           atts;
+	int                    atts_size;
+} xml_istreamScan_t;
+
+// reserves the arena and atts without a record
+static int xml_istream_logReserve(xml_istreamLog_t* log,
+                                  size_t len, int natts)
+{
+	ASSERT(log);
+
+	if((log->arena_len + len) > log->arena_size)
+	{
+		size_t size = log->arena_size ? log->arena_size : 4096;
+		while(size < (log->arena_len + len))
+		{
+			size *= 2;
+		}
+
+		char* arena = (char*) REALLOC(log->arena, size);
+		if(arena == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		log->arena      = arena;
+		log->arena_size = size;
+	}
+
+	if((log->atts_count + natts) > log->atts_size)
+	{
+		int size = log->atts_size ? log->atts_size : 256;
+		while(size < (log->atts_count + natts))
+		{
+			size *= 2;
+		}
+
+		size_t* atts = (size_t*)
+		               REALLOC(log->atts, size*sizeof(size_t));
+		if(atts == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		log->atts      = atts;
+		log->atts_size = size;
+	}
+
+	return 1;
+}
+
+static int xml_istream_logResize(xml_istreamLog_t* log,
+                                 size_t len, int natts)
+{
+	ASSERT(log);
+
+	if(log->records_count == log->records_size)
+	{
+		int size = log->records_size ? 2*log->records_size : 256;
+
+		xml_istreamRecord_t* records;
+		records = (xml_istreamRecord_t*)
+		          REALLOC(log->records,
+		                  size*sizeof(xml_istreamRecord_t));
+		if(records == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		log->records      = records;
+		log->records_size = size;
+	}
+
+	return xml_istream_logReserve(log, len, natts);
+}
+
+static size_t
+xml_istream_logString(xml_istreamLog_t* log,
+                      const char* str, size_t len)
+{
+	ASSERT(log);
+	ASSERT(str);
+
+	size_t offset = log->arena_len;
+	memcpy(&log->arena[offset], str, len);
+	log->arena[offset + len] = '\0';
+	log->arena_len += len + 1;
+
+	return offset;
+}
+
+static void xml_istream_logClear(xml_istreamLog_t* log)
+{
+	ASSERT(log);
+
+	log->arena_len     = 0;
+	log->records_count = 0;
+	log->atts_count    = 0;
+}
+
+static void xml_istream_logFree(xml_istreamLog_t* log)
+{
+	ASSERT(log);
+
+	FREE(log->arena);
+	FREE(log->records);
+	FREE(log->atts);
+}
+
+static xml_istreamRecord_t*
+xml_istream_logStart(xml_istreamLog_t* log, int line,
+                     const char* name, const char** atts)
+{
+	ASSERT(log);
 	ASSERT(name);
 	ASSERT(atts);
 
-	xml_istream_t* self = (xml_istream_t*) _self;
-	xml_istream_start_fn start_fn = self->start_fn;
+	// measure the event
+	int    natts = 0;
+	size_t len   = strlen(name) + 1;
+	while(atts[natts])
+	{
+		len += strlen(atts[natts]) + 1;
+		++natts;
+	}
 
-	int line = XML_GetCurrentLineNumber(self->parser);
-	if((*start_fn)(self->priv, line, self->progress,
-	               name, atts) == 0)
+	if(xml_istream_logResize(log, len, natts) == 0)
 	{
-		self->error = 1;
+		return NULL;
+	}
+
+	xml_istreamRecord_t* record;
+	record = &log->records[log->records_count];
+	record->type  = XML_ISTREAM_RECORD_START;
+	record->id    = -1;
+	record->depth = 0;
+	record->line  = line;
+	record->name  = xml_istream_logString(log, name,
+	                                      strlen(name));
+	record->atts  = log->atts_count;
+	record->natts = natts;
+
+	int i;
+	for(i = 0; i < natts; ++i)
+	{
+		log->atts[log->atts_count + i] =
+			xml_istream_logString(log, atts[i],
+			                      strlen(atts[i]));
 	}
+	log->atts_count += natts;
+	++log->records_count;
+
+	return record;
 }
 
-static void xml_istream_end(void* _self,
-                            const XML_Char* name)
+static xml_istreamRecord_t*
+xml_istream_logEnd(xml_istreamLog_t* log, int line,
+                   const char* name, const char* content,
+                   size_t len)
 {
-	ASSERT(_self);
+	ASSERT(log);
 	ASSERT(name);
 
-	xml_istream_t* self = (xml_istream_t*) _self;
-	xml_istream_end_fn end_fn = self->end_fn;
+	size_t name_len = strlen(name);
+	if(xml_istream_logResize(log, name_len + len + 2, 0) == 0)
+	{
+		return NULL;
+	}
+
+	xml_istreamRecord_t* record;
+	record = &log->records[log->records_count];
+	record->type    = XML_ISTREAM_RECORD_END;
+	record->id      = -1;
+	record->depth   = 0;
+	record->line    = line;
+	record->name    = xml_istream_logString(log, name, name_len);
+	record->content = content ?
+	                  xml_istream_logString(log, content, len) : 0;
+	record->len     = content ? len : 0;
+	++log->records_count;
+
+	return record;
+}
+
+static void xml_istream_content(void *_self,
+                                const char *content,
+                                int len);
 
-	int line = XML_GetCurrentLineNumber(self->parser);
+static int
+xml_istream_subscribeStart(xml_istream_t* self,
+                           const char* name)
+{
+	ASSERT(self);
+	ASSERT(name);
 
-	// trim leading whitespace
-	char* buf = self->content_buf;
-	if(buf)
+	// advance the path subscriptions which match the parent
+	// element and check for a complete match
+	int match = 0;
+	int depth = self->depth;
+	int i;
+	for(i = 0; i < self->subs_count; ++i)
 	{
-		while(buf[0] != '\0')
+		xml_istreamSubscription_t* sub = &self->subs[i];
+		if(sub->absolute == 0)
 		{
-			char c = buf[0];
-			if((c == '\t') ||
-			   (c == '\n') ||
-			   (c == '\r') ||
-			   (c == ' '))
+			if(strcmp(sub->path, name) == 0)
 			{
-				++buf;
+				match = 1;
 			}
-			else
+		}
+		else if((sub->matched == (depth - 1)) &&
+		        (depth <= sub->ncomp)           &&
+		        (strcmp(&sub->path[sub->comp[depth - 1]],
+		                name) == 0))
+		{
+			sub->matched = depth;
+			if(depth == sub->ncomp)
 			{
-				break;
+				match = 1;
 			}
 		}
+	}
+
+	return match;
+}
 
-		// pass NULL for empty content
-		if(buf[0] == '\0')
+static void xml_istream_subscribeEnd(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	int i;
+	for(i = 0; i < self->subs_count; ++i)
+	{
+		xml_istreamSubscription_t* sub = &self->subs[i];
+		if(sub->matched == self->depth)
 		{
-			buf = NULL;
+			--sub->matched;
 		}
 	}
+}
 
-	if((*end_fn)(self->priv, line, self->progress,
-	             name, buf) == 0)
+static int
+xml_istream_subscribeCopy(xml_istream_t* self,
+                          xml_istream_t* src)
+{
+	ASSERT(self);
+	ASSERT(src);
+
+	if(src->subs_count == 0)
 	{
-		self->error = 1;
+		return 1;
 	}
 
-	FREE(self->content_buf);
-	self->content_buf = NULL;
-	self->content_len = 0;
+	size_t size = src->subs_count*
+	              sizeof(xml_istreamSubscription_t);
+
+	xml_istreamSubscription_t* subs;
+	subs = (xml_istreamSubscription_t*)
+	       REALLOC(self->subs, size);
+	if(subs == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	memcpy(subs, src->subs, size);
+
+	self->subs       = subs;
+	self->subs_count = src->subs_count;
+
+	return 1;
 }
 
-static void xml_istream_content(void *_self,
-                                const char *content,
-                                int len)
+static int
+xml_istream_nameId(xml_istream_t* self,
+                   const char* name, int discover)
 {
-	ASSERT(_self);
-	ASSERT(content);
+	ASSERT(self);
+	ASSERT(name);
 
-	xml_istream_t* self = (xml_istream_t*) _self;
+	if(self->intern == NULL)
+	{
+		return -1;
+	}
 
-	int len2  = len + self->content_len;
-	int len21 = len2 + 1;
-	char* buffer = (char*)
-	               REALLOC(self->content_buf,
-	                       len21*sizeof(char));
-	if(buffer == NULL)
+	int id = xml_intern_find(self->intern, name);
+	if((id < 0) && discover)
 	{
-		LOGE("relloc failed");
-		self->error = 1;
-		return;
+		id = xml_intern_add(self->intern, name);
 	}
-	self->content_buf = buffer;
 
-	char* dst = &(self->content_buf[self->content_len]);
-	memcpy(dst, content, len);
-	self->content_buf[len2] = '\0';
-	self->content_len       = len2;
+	return id;
 }
 
-static xml_istream_t*
-xml_istream_new(void* priv,
-                xml_istream_start_fn start_fn,
-                xml_istream_end_fn   end_fn)
+static xml_istream_start_fn
+xml_istream_startFn(xml_istream_t* self, int id)
 {
-	// priv may be NULL
-	ASSERT(start_fn);
-	ASSERT(end_fn);
+	ASSERT(self);
 
-	xml_istream_t* self = (xml_istream_t*)
-	                      CALLOC(1, sizeof(xml_istream_t));
-	if(self == NULL)
+	if((id >= 0) && (id < self->handlers_count) &&
+	   self->handlers[id].start_fn)
 	{
-		LOGE("CALLOC failed");
-		return NULL;
+		return self->handlers[id].start_fn;
 	}
 
-	XML_Parser parser = XML_ParserCreate("UTF-8");
-	if(parser == NULL)
+	return self->start_fn;
+}
+
+static xml_istream_end_fn
+xml_istream_endFn(xml_istream_t* self, int id)
+{
+	ASSERT(self);
+
+	if((id >= 0) && (id < self->handlers_count) &&
+	   self->handlers[id].end_fn)
 	{
-		LOGE("XML_ParserCreate failed");
-		goto fail_parser;
+		return self->handlers[id].end_fn;
 	}
-	XML_SetUserData(parser, (void*) self);
-	XML_SetElementHandler(parser,
-	                      xml_istream_start,
-	                      xml_istream_end);
-	XML_SetCharacterDataHandler(parser,
-	                            xml_istream_content);
 
-	self->priv     = priv;
-	self->start_fn = start_fn;
-	self->end_fn   = end_fn;
-	self->parser   = parser;
+	return self->end_fn;
+}
 
-	// success
-	return self;
+static int xml_istream_pushId(xml_istream_t* self, int id)
+{
+	ASSERT(self);
 
-	// failure
-	fail_parser:
-		FREE(self);
-	return NULL;
+	if(self->depth > self->ids_size)
+	{
+		int size = self->ids_size ? 2*self->ids_size : 32;
+		int* ids = (int*) REALLOC(self->ids, size*sizeof(int));
+		if(ids == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->ids      = ids;
+		self->ids_size = size;
+	}
+
+	self->ids[self->depth - 1] = id;
+	return 1;
 }
 
-static void xml_istream_delete(xml_istream_t** _self)
+// checkpoint file header which is followed by the names
+// of the open elements and the access point for gzip
+#define XML_ISTREAM_CHECKPOINT_MAGIC "XMLCKPT1"
+
+typedef struct
 {
-	ASSERT(_self);
+	char    magic[8];
+	int64_t offset;
+	int     line;
+	int     depth;
+	int64_t names_len;
+	int     gz;
+} xml_istreamCheckpoint_t;
 
-	xml_istream_t* self = *_self;
-	if(self)
+static double xml_istream_statsTime(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	return self->stats ? xml_stats_time() : 0.0;
+}
+
+static void xml_istream_statsIo(xml_istream_t* self, double t0)
+{
+	ASSERT(self);
+
+	if(self->stats)
 	{
-		XML_ParserFree(self->parser);
-		FREE(self->content_buf);
-		FREE(self);
-		*_self = NULL;
+		self->stats->time_io += xml_stats_time() - t0;
 	}
 }
 
-static int
-xml_istream_parseGzFile(void* priv,
-                        xml_istream_start_fn start_fn,
-                        xml_istream_end_fn   end_fn,
-                        gzFile f, size_t len)
+static void
+xml_istream_statsCallback(xml_istream_t* self, double t0,
+                          int events)
 {
-	// priv may be NULL
-	ASSERT(start_fn);
-	ASSERT(end_fn);
-	ASSERT(f);
+	ASSERT(self);
 
-	if(len <= 0)
+	if(self->stats)
 	{
-		LOGE("invalid len=%i", (int) len);
-		return 0;
+		self->stats->time_callback += xml_stats_time() - t0;
+		self->stats->events        += events;
 	}
+}
 
-	xml_istream_t* self;
-	self = xml_istream_new(priv, start_fn, end_fn);
-	if(self == NULL)
+// the expat time excludes the callbacks and allocations
+// which are measured by the handlers
+static double xml_istream_statsNested(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(self->stats)
 	{
-		return 0;
+		return self->stats->time_callback +
+		       self->stats->time_alloc;
 	}
+	return 0.0;
+}
 
-	// parse file
-	int    done  = 0;
-	size_t part  = 0;
-	size_t total = len;
-	while(done == 0)
+static void
+xml_istream_statsParse(xml_istream_t* self, double t0,
+                       double nested, int len)
+{
+	ASSERT(self);
+
+	xml_stats_t* stats = self->stats;
+	if(stats)
 	{
-		void* buf = XML_GetBuffer(self->parser, 4096);
-		if(buf == NULL)
-		{
-			LOGE("XML_GetBuffer buf=NULL");
-			goto fail_parse;
-		}
+		double dt = xml_stats_time() - t0;
+		stats->time_parse += dt -
+		                     (xml_istream_statsNested(self) - nested);
+		stats->bytes      += len;
+	}
 
-		int bytes = gzread(f, buf, 4096);
-		if((bytes == 0) && (gzeof(f) == 0))
-		{
-			LOGE("gzread failed");
-			goto fail_parse;
-		}
+	// throttle the progress callback
+	if(self->progress_fn == NULL)
+	{
+		return;
+	}
+
+	double t = xml_stats_time();
+	if(self->progress_t0 == 0.0)
+	{
+		self->progress_t0   = t;
+		self->progress_last = t;
+		return;
+	}
+	else if((t - self->progress_last) < self->progress_interval)
+	{
+		return;
+	}
+	self->progress_last = t;
+
+	// the eta is unknown until progress is made
+	float  progress = self->progress;
+	double elapsed  = t - self->progress_t0;
+	double eta      = -1.0;
+	if(progress >= 1.0f)
+	{
+		eta = 0.0;
+	}
+	else if(progress > 0.0f)
+	{
+		eta = elapsed*(1.0 - progress)/progress;
+	}
+
+	if((*self->progress_fn)(self->priv, progress, elapsed, eta,
+	                        stats) == 0)
+	{
+		self->error = 1;
+	}
+}
+
+static enum XML_Status
+xml_istream_expatParse(xml_istream_t* self,
+                       const char* buf, int len, int final)
+{
+	ASSERT(self);
+
+	self->fed += len;
+
+	if((self->stats == NULL) && (self->progress_fn == NULL))
+	{
+		return XML_Parse(self->parser, buf, len, final);
+	}
+
+	double nested = xml_istream_statsNested(self);
+	double t0     = xml_stats_time();
+
+	enum XML_Status status;
+	status = XML_Parse(self->parser, buf, len, final);
+	xml_istream_statsParse(self, t0, nested, len);
+	return status;
+}
+
+static enum XML_Status
+xml_istream_expatParseBuffer(xml_istream_t* self,
+                             int len, int final)
+{
+	ASSERT(self);
+
+	self->fed += len;
+
+	if((self->stats == NULL) && (self->progress_fn == NULL))
+	{
+		return XML_ParseBuffer(self->parser, len, final);
+	}
+
+	double nested = xml_istream_statsNested(self);
+	double t0     = xml_stats_time();
+
+	enum XML_Status status;
+	status = XML_ParseBuffer(self->parser, len, final);
+	xml_istream_statsParse(self, t0, nested, len);
+	return status;
+}
+
+static enum XML_Status
+xml_istream_expatResume(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if((self->stats == NULL) && (self->progress_fn == NULL))
+	{
+		return XML_ResumeParser(self->parser);
+	}
+
+	double nested = xml_istream_statsNested(self);
+	double t0     = xml_stats_time();
+
+	enum XML_Status status;
+	status = XML_ResumeParser(self->parser);
+	xml_istream_statsParse(self, t0, nested, 0);
+	return status;
+}
+
+static int xml_istream_line(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(self->scan && self->scan->active)
+	{
+		return self->scan->line;
+	}
+
+	return XML_GetCurrentLineNumber(self->parser) +
+	       self->line_offset;
+}
+
+// the offset after the current token
+static int64_t xml_istream_offset(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(self->scan && self->scan->active)
+	{
+		return self->scan->offset;
+	}
+
+	return (int64_t) (XML_GetCurrentByteIndex(self->parser) +
+	                  XML_GetCurrentByteCount(self->parser)) +
+	       self->checkpoint_base;
+}
+
+static void xml_istream_batchDelete(xml_istreamBatch_t** _batch)
+{
+	ASSERT(_batch);
+
+	xml_istreamBatch_t* batch = *_batch;
+	if(batch)
+	{
+		xml_istream_logFree(&batch->log);
+		FREE(batch->events);
+		FREE(batch->atts);
+		FREE(batch);
+		*_batch = NULL;
+	}
+}
+
+static int xml_istream_batchFlush(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	xml_istreamBatch_t* batch = self->batch;
+	xml_istreamLog_t*   log   = &batch->log;
+	if(log->records_count == 0)
+	{
+		return 1;
+	}
+
+	// each start event needs a NULL terminated atts array
+	int size = log->atts_count + log->records_count;
+	if(size > batch->atts_size)
+	{
+		const char** atts;
+		atts = (const char**)
+		       REALLOC(batch->atts, size*sizeof(const char*));
+		if(atts == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		batch->atts      = atts;
+		batch->atts_size = size;
+	}
+
+	// rebuild the events once the arena no longer moves
+	int i;
+	int j;
+	int k = 0;
+	for(i = 0; i < log->records_count; ++i)
+	{
+		xml_istreamRecord_t* record = &log->records[i];
+		xml_istreamEvent_t*  event  = &batch->events[i];
+		event->id       = record->id;
+		event->depth    = record->depth;
+		event->line     = record->line;
+		event->progress = self->progress;
+		event->name     = &log->arena[record->name];
+		if(record->type == XML_ISTREAM_RECORD_START)
+		{
+			event->type    = XML_ISTREAM_EVENT_START;
+			event->atts    = &batch->atts[k];
+			event->content = NULL;
+			event->len     = 0;
+			for(j = 0; j < record->natts; ++j)
+			{
+				batch->atts[k++] =
+					&log->arena[log->atts[record->atts + j]];
+			}
+			batch->atts[k++] = NULL;
+		}
+		else
+		{
+			event->type    = XML_ISTREAM_EVENT_END;
+			event->atts    = NULL;
+			event->content = record->len ?
+			                 &log->arena[record->content] : NULL;
+			event->len     = record->len;
+		}
+	}
+
+	int    count = log->records_count;
+	double t0    = xml_istream_statsTime(self);
+	xml_istream_logClear(log);
+	int ret = (*batch->batch_fn)(self->priv, count,
+	                             batch->events);
+	xml_istream_statsCallback(self, t0, count);
+
+	// skip is equivalent to continue since the events were
+	// already parsed
+	if(ret == XML_ISTREAM_STOP)
+	{
+		self->stopped = 1;
+		XML_StopParser(self->parser, XML_FALSE);
+	}
+	return (ret == XML_ISTREAM_ABORT) ? 0 : 1;
+}
+
+static void
+xml_istream_batchStart(xml_istream_t* self, int id,
+                       const char* name, const char** atts)
+{
+	ASSERT(self);
+	ASSERT(name);
+	ASSERT(atts);
+
+	xml_istreamBatch_t* batch = self->batch;
+
+	int line = 0;
+	if(batch->lines)
+	{
+		line = xml_istream_line(self);
+	}
+
+	xml_istreamRecord_t* record;
+	record = xml_istream_logStart(&batch->log, line,
+	                              name, atts);
+	if(record == NULL)
+	{
+		self->error = 1;
+		return;
+	}
+	record->id    = id;
+	record->depth = self->depth;
+
+	if((batch->log.records_count == batch->count) &&
+	   (xml_istream_batchFlush(self) == 0))
+	{
+		self->error = 1;
+	}
+}
+
+static void
+xml_istream_batchEnd(xml_istream_t* self, int id,
+                     const char* name, const char* content,
+                     size_t len)
+{
+	ASSERT(self);
+	ASSERT(name);
+
+	xml_istreamBatch_t* batch = self->batch;
+
+	int line = 0;
+	if(batch->lines)
+	{
+		line = xml_istream_line(self);
+	}
+
+	xml_istreamRecord_t* record;
+	record = xml_istream_logEnd(&batch->log, line, name,
+	                            content, len);
+	if(record == NULL)
+	{
+		self->error = 1;
+		return;
+	}
+	record->id    = id;
+	record->depth = self->depth;
+
+	if((batch->log.records_count == batch->count) &&
+	   (xml_istream_batchFlush(self) == 0))
+	{
+		self->error = 1;
+	}
+}
+
+static void xml_istream_treeDelete(xml_istreamTree_t** _tree)
+{
+	ASSERT(_tree);
+
+	xml_istreamTree_t* tree = *_tree;
+	if(tree)
+	{
+		xml_istream_logFree(&tree->log);
+		FREE(tree->names);
+		FREE(tree->nodes);
+		FREE(tree->levels);
+		FREE(tree->out);
+		FREE(tree->atts);
+		FREE(tree);
+		*_tree = NULL;
+	}
+}
+
+static void xml_istream_treeClear(xml_istreamTree_t* tree)
+{
+	ASSERT(tree);
+
+	xml_istream_logClear(&tree->log);
+	tree->tree_fn     = NULL;
+	tree->depth       = 0;
+	tree->nodes_count = 0;
+}
+
+static int
+xml_istream_treeResize(xml_istreamTree_t* tree, int level)
+{
+	ASSERT(tree);
+
+	if(tree->nodes_count == tree->nodes_size)
+	{
+		int size = tree->nodes_size ? 2*tree->nodes_size : 64;
+
+		xml_istreamTreeNode_t* nodes;
+		nodes = (xml_istreamTreeNode_t*)
+		        REALLOC(tree->nodes,
+		                size*sizeof(xml_istreamTreeNode_t));
+		if(nodes == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		tree->nodes      = nodes;
+		tree->nodes_size = size;
+	}
+
+	if(level >= tree->levels_size)
+	{
+		int size = 2*(level + 1);
+
+		xml_istreamTreeLevel_t* levels;
+		levels = (xml_istreamTreeLevel_t*)
+		         REALLOC(tree->levels,
+		                 size*sizeof(xml_istreamTreeLevel_t));
+		if(levels == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		tree->levels      = levels;
+		tree->levels_size = size;
+	}
+
+	return 1;
+}
+
+// returns 1 when the element is recorded in a tree
+static int
+xml_istream_treeStart(xml_istream_t* self,
+                      const char* name, const char** atts)
+{
+	ASSERT(self);
+	ASSERT(name);
+	ASSERT(atts);
+
+	xml_istreamTree_t* tree = self->tree;
+
+	// begin a tree at a materialized element
+	if(tree->depth == 0)
+	{
+		int i;
+		for(i = 0; i < tree->names_count; ++i)
+		{
+			if(strcmp(tree->names[i].name, name) == 0)
+			{
+				break;
+			}
+		}
+
+		if(i == tree->names_count)
+		{
+			return 0;
+		}
+
+		tree->tree_fn = tree->names[i].tree_fn;
+		tree->depth   = self->depth;
+	}
+
+	// measure the node
+	int    natts = 0;
+	size_t len   = strlen(name) + 1;
+	while(atts[natts])
+	{
+		len += strlen(atts[natts]) + 1;
+		++natts;
+	}
+
+	int level = self->depth - tree->depth;
+	xml_istreamLog_t* log = &tree->log;
+	if((xml_istream_treeResize(tree, level) == 0) ||
+	   (xml_istream_logReserve(log, len, natts) == 0))
+	{
+		xml_istream_treeClear(tree);
+		self->error = 1;
+		return 1;
+	}
+
+	// link the node to its parent and previous sibling
+	int n = tree->nodes_count++;
+	xml_istreamTreeNode_t* node = &tree->nodes[n];
+	node->parent  = -1;
+	node->next    = -1;
+	node->count   = 1;
+	node->line    = xml_istream_line(self);
+	node->name    = xml_istream_logString(log, name,
+	                                      strlen(name));
+	node->atts    = log->atts_count;
+	node->natts   = natts;
+	node->content = 0;
+	node->len     = 0;
+	if(level > 0)
+	{
+		xml_istreamTreeLevel_t* parent = &tree->levels[level - 1];
+		node->parent = parent->node;
+		if(parent->last >= 0)
+		{
+			tree->nodes[parent->last].next = n;
+		}
+		parent->last = n;
+	}
+	tree->levels[level].node = n;
+	tree->levels[level].last = -1;
+
+	int i;
+	for(i = 0; i < natts; ++i)
+	{
+		log->atts[log->atts_count + i] =
+			xml_istream_logString(log, atts[i],
+			                      strlen(atts[i]));
+	}
+	log->atts_count += natts;
+
+	return 1;
+}
+
+static int xml_istream_treeDeliver(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	xml_istreamTree_t* tree  = self->tree;
+	xml_istreamLog_t*  log   = &tree->log;
+	int                count = tree->nodes_count;
+
+	// each node needs a NULL terminated atts array
+	if(count > tree->out_size)
+	{
+		xml_istreamNode_t* out;
+		out = (xml_istreamNode_t*)
+		      REALLOC(tree->out, count*sizeof(xml_istreamNode_t));
+		if(out == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		tree->out      = out;
+		tree->out_size = count;
+	}
+
+	int size = log->atts_count + count;
+	if(size > tree->atts_size)
+	{
+		const char** atts;
+		atts = (const char**)
+		       REALLOC(tree->atts, size*sizeof(const char*));
+		if(atts == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		tree->atts      = atts;
+		tree->atts_size = size;
+	}
+
+	// rebuild the nodes once the arena no longer moves
+	int i;
+	int j;
+	int k = 0;
+	for(i = 0; i < count; ++i)
+	{
+		xml_istreamTreeNode_t* node = &tree->nodes[i];
+		xml_istreamNode_t*     out  = &tree->out[i];
+		out->parent  = node->parent;
+		out->next    = node->next;
+		out->count   = node->count;
+		out->line    = node->line;
+		out->name    = &log->arena[node->name];
+		out->atts    = &tree->atts[k];
+		out->content = node->len ?
+		               &log->arena[node->content] : NULL;
+		out->len     = node->len;
+		for(j = 0; j < node->natts; ++j)
+		{
+			tree->atts[k++] =
+				&log->arena[log->atts[node->atts + j]];
+		}
+		tree->atts[k++] = NULL;
+	}
+
+	double t0  = xml_istream_statsTime(self);
+	int    ret = (*tree->tree_fn)(self->priv, self->progress,
+	                              count, tree->out);
+	xml_istream_statsCallback(self, t0, 2*count);
+	return ret;
+}
+
+static void
+xml_istream_treeEnd(xml_istream_t* self,
+                    const char* content, size_t len)
+{
+	ASSERT(self);
+
+	xml_istreamTree_t* tree = self->tree;
+	xml_istreamLog_t*  log  = &tree->log;
+
+	int level = self->depth - tree->depth;
+	int n     = tree->levels[level].node;
+	if(content)
+	{
+		if(xml_istream_logReserve(log, len + 1, 0) == 0)
+		{
+			self->error = 1;
+			return;
+		}
+
+		tree->nodes[n].content =
+			xml_istream_logString(log, content, len);
+		tree->nodes[n].len = len;
+	}
+	tree->nodes[n].count = tree->nodes_count - n;
+
+	// deliver the tree at the end of the materialized
+	// element and reset the arena for the next tree
+	// where skip is equivalent to continue
+	if(level == 0)
+	{
+		if(self->error == 0)
+		{
+			int ret = xml_istream_treeDeliver(self);
+			if(ret == XML_ISTREAM_STOP)
+			{
+				self->stopped = 1;
+				XML_StopParser(self->parser, XML_FALSE);
+			}
+			else if(ret == XML_ISTREAM_ABORT)
+			{
+				self->error = 1;
+			}
+		}
+		xml_istream_treeClear(tree);
+	}
+}
+
+static int
+xml_istream_checkpointPush(xml_istream_t* self,
+                           const char* name)
+{
+	ASSERT(self);
+	ASSERT(name);
+
+	if(self->depth > self->checkpoint_stack_size)
+	{
+		int size = self->checkpoint_stack_size ?
+		           2*self->checkpoint_stack_size : 32;
+
+		size_t* stack;
+		stack = (size_t*)
+		        REALLOC(self->checkpoint_stack,
+		                size*sizeof(size_t));
+		if(stack == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->checkpoint_stack      = stack;
+		self->checkpoint_stack_size = size;
+	}
+
+	size_t len  = strlen(name) + 1;
+	size_t len2 = self->checkpoint_names_len + len;
+	if(len2 > self->checkpoint_names_size)
+	{
+		size_t size = self->checkpoint_names_size ?
+		              self->checkpoint_names_size : 256;
+		while(size < len2)
+		{
+			size *= 2;
+		}
+
+		char* names = (char*)
+		              REALLOC(self->checkpoint_names, size);
+		if(names == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->checkpoint_names      = names;
+		self->checkpoint_names_size = size;
+	}
+
+	size_t offset = self->checkpoint_names_len;
+	memcpy(&self->checkpoint_names[offset], name, len);
+	self->checkpoint_stack[self->depth - 1] = offset;
+	self->checkpoint_names_len              = len2;
+
+	return 1;
+}
+
+static void xml_istream_checkpointWrite(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	// the checkpoint resumes after the current end tag
+	int64_t offset = xml_istream_offset(self);
+
+	// gzip checkpoints wait for a new access point before
+	// the offset which is captured every interval bytes
+	xml_inflate_t* inflate = self->checkpoint_inflate;
+	if(inflate)
+	{
+		if((inflate->point_count == self->checkpoint_points) ||
+		   (inflate->point.out > offset))
+		{
+			return;
+		}
+	}
+	else if(offset < (int64_t) (self->checkpoint_last +
+	                            self->checkpoint_interval))
+	{
+		return;
+	}
+
+	// the open tree would be skipped by restore
+	if(self->tree && self->tree->depth)
+	{
+		return;
+	}
+
+	// the batched events before the checkpoint must be
+	// delivered since they are skipped by restore
+	if(self->batch && (xml_istream_batchFlush(self) == 0))
+	{
+		self->error = 1;
+		return;
+	}
+
+	// a failed checkpoint is not retried until the next
+	// interval so the parse continues
+	self->checkpoint_last   = (size_t) offset;
+	self->checkpoint_points = inflate ? inflate->point_count : 0;
+
+	xml_istreamCheckpoint_t ck;
+	memset(&ck, 0, sizeof(xml_istreamCheckpoint_t));
+	memcpy(ck.magic, XML_ISTREAM_CHECKPOINT_MAGIC, 8);
+	ck.offset    = offset;
+	ck.line      = xml_istream_line(self);
+	ck.depth     = self->depth - 1;
+	ck.names_len = (int64_t) self->checkpoint_names_len;
+	ck.gz        = inflate ? 1 : 0;
+
+	// write a temporary file and rename it so that the
+	// previous checkpoint remains valid if the write fails
+	char tmp[256];
+	snprintf(tmp, 256, "%s.tmp", self->checkpoint_fname);
+	FILE* f = fopen(tmp, "w");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", tmp);
+		return;
+	}
+
+	if((fwrite(&ck, sizeof(xml_istreamCheckpoint_t), 1,
+	           f) != 1) ||
+	   (ck.names_len &&
+	    (fwrite(self->checkpoint_names, ck.names_len, 1,
+	            f) != 1)) ||
+	   (inflate &&
+	    (fwrite(&inflate->point, sizeof(xml_inflatePoint_t), 1,
+	            f) != 1)) ||
+	   (fflush(f) != 0) || (fsync(fileno(f)) != 0))
+	{
+		LOGE("fwrite %s failed", tmp);
+		goto fail_write;
+	}
+	fclose(f);
+
+	if(rename(tmp, self->checkpoint_fname) != 0)
+	{
+		LOGE("rename %s failed", tmp);
+		unlink(tmp);
+	}
+
+	// success
+	return;
+
+	// failure
+	fail_write:
+		fclose(f);
+		unlink(tmp);
+}
+
+static int
+xml_istream_checkpointLoad(const char* ckname,
+                           xml_istreamCheckpoint_t* ck,
+                           char** _names,
+                           xml_inflatePoint_t* point,
+                           int* _exists)
+{
+	ASSERT(ckname);
+	ASSERT(ck);
+	ASSERT(_names);
+	ASSERT(_exists);
+
+	// point may be NULL for uncompressed input
+
+	*_names  = NULL;
+	*_exists = 0;
+
+	FILE* f = fopen(ckname, "r");
+	if(f == NULL)
+	{
+		return 1;
+	}
+	*_exists = 1;
+
+	if((fread(ck, sizeof(xml_istreamCheckpoint_t), 1,
+	          f) != 1) ||
+	   (memcmp(ck->magic, XML_ISTREAM_CHECKPOINT_MAGIC, 8) != 0) ||
+	   (ck->offset < 0) || (ck->depth < 1) ||
+	   (ck->names_len < ck->depth) ||
+	   (ck->names_len > 0x40000000) ||
+	   (ck->gz != (point ? 1 : 0)))
+	{
+		LOGE("invalid %s", ckname);
+		goto fail_header;
+	}
+
+	char* names = (char*) MALLOC((size_t) ck->names_len);
+	if(names == NULL)
+	{
+		LOGE("MALLOC failed");
+		goto fail_names;
+	}
+
+	if(fread(names, (size_t) ck->names_len, 1, f) != 1)
+	{
+		LOGE("fread %s failed", ckname);
+		goto fail_read;
+	}
+
+	// the names must contain depth strings
+	int     count = 0;
+	int64_t i;
+	for(i = 0; i < ck->names_len; ++i)
+	{
+		if(names[i] == '\0')
+		{
+			++count;
+		}
+	}
+	if((count != ck->depth) ||
+	   (names[ck->names_len - 1] != '\0'))
+	{
+		LOGE("invalid %s", ckname);
+		goto fail_read;
+	}
+
+	if(point &&
+	   (fread(point, sizeof(xml_inflatePoint_t), 1, f) != 1))
+	{
+		LOGE("fread %s failed", ckname);
+		goto fail_read;
+	}
+	fclose(f);
+
+	*_names = names;
+
+	// success
+	return 1;
+
+	// failure
+	fail_read:
+		FREE(names);
+	fail_names:
+	fail_header:
+		fclose(f);
+	return 0;
+}
+
+static int
+xml_istream_reopen(xml_istream_t* self,
+                   const char* names, int depth,
+                   int line, int64_t* _prefix)
+{
+	ASSERT(self);
+	ASSERT(names);
+	ASSERT(_prefix);
+
+	// reopen the elements which were open at an offset
+	// without start callbacks where the line is restored by
+	// the line offset since the start tags do not contain
+	// newlines
+	// expat may defer the last start tag until more input
+	// is parsed so the start handler counts the elements
+	self->line_offset        = line - 1;
+	self->checkpoint_restore = depth;
+
+	int64_t     prefix = 0;
+	const char* name   = names;
+	int         i;
+	for(i = 0; i < depth; ++i)
+	{
+		int len = (int) strlen(name);
+		if((XML_Parse(self->parser, "<", 1, 0) == XML_STATUS_ERROR) ||
+		   (XML_Parse(self->parser, name, len,
+		              0) == XML_STATUS_ERROR) ||
+		   (XML_Parse(self->parser, ">", 1, 0) == XML_STATUS_ERROR))
+		{
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			LOGE("XML_Parse err=%s, name=%s",
+			     XML_ErrorString(e), name);
+			return 0;
+		}
+		prefix += len + 2;
+		name   += len + 1;
+	}
+	self->fed += prefix;
+
+	*_prefix = prefix;
+	return self->error ? 0 : 1;
+}
+
+static int
+xml_istream_checkpointRestore(xml_istream_t* self,
+                              const xml_istreamCheckpoint_t* ck,
+                              const char* names)
+{
+	ASSERT(self);
+	ASSERT(ck);
+	ASSERT(names);
+
+	int64_t prefix;
+	if(xml_istream_reopen(self, names, ck->depth, ck->line,
+	                      &prefix) == 0)
+	{
+		return 0;
+	}
+
+	// expat byte indices include the restored start tags
+	self->checkpoint_base = ck->offset - prefix;
+	self->checkpoint_last = (size_t) ck->offset;
+
+	return 1;
+}
+
+static void
+xml_istream_pullEvent(xml_istream_t* self, int type,
+                      int id, int line, const char* name,
+                      const char** atts, const char* content,
+                      size_t len)
+{
+	ASSERT(self);
+	ASSERT(name);
+	ASSERT(self->pull_count < 2);
+
+	xml_istreamEvent_t* event;
+	event = &self->pull_events[self->pull_count++];
+	event->type     = type;
+	event->id       = id;
+	event->depth    = self->depth;
+	event->line     = line;
+	event->progress = self->progress;
+	event->name     = name;
+	event->atts     = atts;
+	event->content  = content;
+	event->len      = len;
+
+	// suspend after the current token which may produce a
+	// second event for empty elements
+	// the tag names remain in the expat tag stack and the
+	// attributes remain in the expat temporary pool (which
+	// is cleared without freeing its blocks) until the
+	// parser is resumed
+	if(self->pull_count == 1)
+	{
+		XML_StopParser(self->parser, XML_TRUE);
+	}
+}
+
+static const char*
+xml_istream_skipFind(const char* p, const char* end,
+                     const char* pattern, size_t len)
+{
+	ASSERT(p);
+	ASSERT(end);
+	ASSERT(pattern);
+
+	while((size_t) (end - p) >= len)
+	{
+		p = (const char*) memchr(p, pattern[0],
+		                         (end - p) - len + 1);
+		if(p == NULL)
+		{
+			return NULL;
+		}
+		else if(memcmp(p, pattern, len) == 0)
+		{
+			return p + len;
+		}
+		++p;
+	}
+	return NULL;
+}
+
+static int
+xml_istream_skipScan(const char* buffer, size_t start,
+                     size_t end, size_t* _close)
+{
+	ASSERT(buffer);
+	ASSERT(_close);
+
+	// find the end tag which matches the start tag at start
+	// by scanning for markup with memchr (which is
+	// vectorized by the C library) rather than tokenizing
+	// the subtree
+	int         depth = 0;
+	const char* p     = &buffer[start];
+	const char* e     = &buffer[end];
+	while(p < e)
+	{
+		p = (const char*) memchr(p, '<', e - p);
+		if((p == NULL) || ((e - p) < 2))
+		{
+			return 0;
+		}
+
+		if(p[1] == '/')
+		{
+			p = (const char*) memchr(p, '>', e - p);
+			if(p == NULL)
+			{
+				return 0;
+			}
+			++p;
+
+			--depth;
+			if(depth == 0)
+			{
+				*_close = (size_t) (p - buffer);
+				return 1;
+			}
+		}
+		else if(p[1] == '?')
+		{
+			p = xml_istream_skipFind(p + 2, e, "?>", 2);
+		}
+		else if(((e - p) >= 4) && (memcmp(p, "<!--", 4) == 0))
+		{
+			p = xml_istream_skipFind(p + 4, e, "-->", 3);
+		}
+		else if(((e - p) >= 9) &&
+		        (memcmp(p, "<![CDATA[", 9) == 0))
+		{
+			p = xml_istream_skipFind(p + 9, e, "]]>", 3);
+		}
+		else if(p[1] == '!')
+		{
+			p = xml_istream_skipFind(p + 2, e, ">", 1);
+		}
+		else
+		{
+			// attribute values may contain '>'
+			const char* q     = p + 1;
+			char        quote = 0;
+			while(q < e)
+			{
+				char c = *q;
+				if(quote)
+				{
+					if(c == quote)
+					{
+						quote = 0;
+					}
+				}
+				else if((c == '"') || (c == '\''))
+				{
+					quote = c;
+				}
+				else if(c == '>')
+				{
+					break;
+				}
+				++q;
+			}
+
+			if(q == e)
+			{
+				return 0;
+			}
+			else if(q[-1] != '/')
+			{
+				++depth;
+			}
+			p = q + 1;
+		}
+
+		if(p == NULL)
+		{
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+static void xml_istream_start(void* _self,
+                              const XML_Char* name,
+                              const XML_Char** atts)
+{
+	ASSERT(_self);
+	ASSERT(name);
+	ASSERT(atts);
+
+	xml_istream_t* self = (xml_istream_t*) _self;
+	xml_istream_start_fn start_fn = self->start_fn;
+	int id = -1;
+
+	// expat may call handlers for the remainder of the
+	// current token after the parser was stopped
+	if(self->stopped)
+	{
+		return;
+	}
+
+	++self->depth;
+	if(self->stats && (self->depth > self->stats->max_depth))
+	{
+		self->stats->max_depth = self->depth;
+	}
+
+	// track the open elements for checkpoints, for
+	// reopening the ancestors of fast skipped subtrees and
+	// for matching end tags in the scanner
+	if((self->checkpoint_interval || self->skip_fast ||
+	    self->scan) &&
+	   (xml_istream_checkpointPush(self, name) == 0))
+	{
+		self->error = 1;
+		return;
+	}
+
+	// the reopened elements were delivered before the
+	// checkpoint, index entry or skipped subtree but must
+	// still advance the subscriptions
+	int restore = 0;
+	if(self->checkpoint_restore)
+	{
+		--self->checkpoint_restore;
+		restore = 1;
+	}
+
+	// skip elements outside of the subscribed subtrees and
+	// only buffer content inside of subscribed subtrees
+	if(self->subs_count && (self->subs_depth == 0))
+	{
+		if(xml_istream_subscribeStart(self, name) == 0)
+		{
+			return;
+		}
+
+		self->subs_depth = self->depth;
+		XML_SetCharacterDataHandler(self->parser,
+		                            xml_istream_content);
+	}
+
+	// dispatch interned names to their handlers
+	if(self->intern)
+	{
+		id = xml_istream_nameId(self, name,
+		                        self->intern_discover);
+		if(xml_istream_pushId(self, id) == 0)
+		{
+			self->error = 1;
+			return;
+		}
+		start_fn = xml_istream_startFn(self, id);
+	}
+
+	if(restore)
+	{
+		return;
+	}
+
+	// ignore the elements of a skipped subtree
+	if(self->skip_depth)
+	{
+		return;
+	}
+
+	if(self->tree && (self->pull == 0) &&
+	   xml_istream_treeStart(self, name, atts))
+	{
+		return;
+	}
+
+	if(self->batch && (self->pull == 0))
+	{
+		xml_istream_batchStart(self, id, name, atts);
+		return;
+	}
+
+	int line = xml_istream_line(self);
+	if(self->pull)
+	{
+		xml_istream_pullEvent(self, XML_ISTREAM_EVENT_START,
+		                      id, line, name, atts, NULL, 0);
+		return;
+	}
+
+	ASSERT(start_fn);
+	double t0  = xml_istream_statsTime(self);
+	int    ret = (*start_fn)(self->priv, line, self->progress,
+	                         name, atts);
+	xml_istream_statsCallback(self, t0, 1);
+	if(ret == XML_ISTREAM_SKIP)
+	{
+		self->skip_depth = self->depth;
+		XML_SetCharacterDataHandler(self->parser, NULL);
+
+		// memory input suspends the parser so the subtree
+		// may be fast-forwarded by xml_istream_parseRange
+		// unless expat already has the entire subtree
+		if(self->skip_fast && self->skip_end &&
+		   (self->depth > 1))
+		{
+			int64_t     index = XML_GetCurrentByteIndex(self->parser);
+			const char* tag   = self->skip_end -
+			                    (self->fed - index);
+			size_t      close;
+			if(xml_istream_skipScan(tag, 0,
+			                        (size_t) (self->skip_end - tag),
+			                        &close) == 0)
+			{
+				self->skip_index   = index;
+				self->skip_line    = line;
+				self->skip_pending = 1;
+				XML_StopParser(self->parser, XML_TRUE);
+			}
+		}
+	}
+	else if(ret == XML_ISTREAM_STOP)
+	{
+		self->stopped = 1;
+		XML_StopParser(self->parser, XML_FALSE);
+	}
+	else if(ret == XML_ISTREAM_ABORT)
+	{
+		self->error = 1;
+	}
+}
+
+static void xml_istream_end(void* _self,
+                            const XML_Char* name)
+{
+	ASSERT(_self);
+	ASSERT(name);
+
+	xml_istream_t* self = (xml_istream_t*) _self;
+	xml_istream_end_fn end_fn = self->end_fn;
+
+	if(self->stopped)
+	{
+		return;
+	}
+
+	if(self->skip_depth)
+	{
+		// leave the skipped subtree without an end callback
+		if(self->skip_depth == self->depth)
+		{
+			self->skip_depth   = 0;
+			self->skip_pending = 0;
+			XML_SetCharacterDataHandler(self->parser,
+			                            xml_istream_content);
+		}
+		self->content_len = 0;
+	}
+	else if((self->subs_count == 0) || self->subs_depth)
+	{
+		int id = -1;
+		if(self->intern)
+		{
+			id     = self->ids[self->depth - 1];
+			end_fn = xml_istream_endFn(self, id);
+		}
+
+		// leading whitespace is trimmed by xml_istream_content
+		// so pass NULL for empty content
+		char* buf = NULL;
+		if(self->content_len)
+		{
+			buf = self->content_buf;
+		}
+
+		if(self->tree && self->tree->depth)
+		{
+			xml_istream_treeEnd(self, buf, self->content_len);
+			if(self->stopped)
+			{
+				return;
+			}
+		}
+		else if(self->batch && (self->pull == 0))
+		{
+			xml_istream_batchEnd(self, id, name, buf,
+			                     self->content_len);
+			if(self->stopped)
+			{
+				return;
+			}
+		}
+		else if(self->pull)
+		{
+			int line = xml_istream_line(self);
+
+			// the content is not overwritten until the parser
+			// is resumed by the next call to xml_istream_next
+			xml_istream_pullEvent(self, XML_ISTREAM_EVENT_END,
+			                      id, line, name, NULL,
+			                      buf, self->content_len);
+		}
+		else
+		{
+			int line = xml_istream_line(self);
+
+			// skip is equivalent to continue for end callbacks
+			ASSERT(end_fn);
+			double t0  = xml_istream_statsTime(self);
+			int    ret = (*end_fn)(self->priv, line,
+			                       self->progress, name, buf,
+			                       self->content_len);
+			xml_istream_statsCallback(self, t0, 1);
+			if(ret == XML_ISTREAM_STOP)
+			{
+				self->stopped = 1;
+				XML_StopParser(self->parser, XML_FALSE);
+				return;
+			}
+			else if(ret == XML_ISTREAM_ABORT)
+			{
+				self->error = 1;
+			}
+		}
+
+		// reuse the content buffer for the next element
+		self->content_len = 0;
+	}
+
+	// leave the subscribed subtree
+	if(self->subs_count)
+	{
+		if(self->subs_depth == self->depth)
+		{
+			self->subs_depth = 0;
+			XML_SetCharacterDataHandler(self->parser, NULL);
+		}
+
+		if(self->subs_depth == 0)
+		{
+			xml_istream_subscribeEnd(self);
+		}
+	}
+
+	// the checkpoint stack excludes the ended element
+	if(self->checkpoint_interval || self->skip_fast ||
+	   self->scan)
+	{
+		self->checkpoint_names_len =
+			self->checkpoint_stack[self->depth - 1];
+		if(self->checkpoint_interval && (self->depth > 1) &&
+		   (self->skip_depth == 0) && (self->error == 0))
+		{
+			xml_istream_checkpointWrite(self);
+		}
+	}
+
+	// deliver the partial batch at the end of the document
+	if(self->batch && (self->depth == 1) &&
+	   (self->error == 0) &&
+	   (xml_istream_batchFlush(self) == 0))
+	{
+		self->error = 1;
+	}
+
+	// stop at the end of the root element when parsing
+	// concatenated documents
+	--self->depth;
+	if(self->concat && (self->depth == 0))
+	{
+		self->doc_done = 1;
+		self->doc_end  = (size_t) xml_istream_offset(self);
+		XML_StopParser(self->parser, XML_FALSE);
+	}
+}
+
+static int
+xml_istream_contentResize(xml_istream_t* self, size_t size)
+{
+	ASSERT(self);
+
+	if(size <= self->content_size)
+	{
+		return 1;
+	}
+
+	// grow the content buffer geometrically
+	size_t size2 = self->content_size ? self->content_size : 256;
+	while(size2 < size)
+	{
+		size2 *= 2;
+	}
+
+	double t0     = xml_istream_statsTime(self);
+	char*  buffer = (char*)
+	                REALLOC(self->content_buf,
+	                        size2*sizeof(char));
+	if(buffer == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	self->content_buf  = buffer;
+	self->content_size = size2;
+
+	if(self->stats)
+	{
+		self->stats->time_alloc += xml_stats_time() - t0;
+		++self->stats->allocs;
+	}
+
+	return 1;
+}
+
+static void xml_istream_content(void *_self,
+                                const char *content,
+                                int len)
+{
+	ASSERT(_self);
+	ASSERT(content);
+
+	xml_istream_t* self = (xml_istream_t*) _self;
+
+	// trim leading whitespace which also avoids buffering the
+	// whitespace between elements
+	if(self->content_len == 0)
+	{
+		while(len > 0)
+		{
+			char c = content[0];
+			if((c == '\t') ||
+			   (c == '\n') ||
+			   (c == '\r') ||
+			   (c == ' '))
+			{
+				++content;
+				--len;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if(len == 0)
+		{
+			return;
+		}
+	}
+
+	size_t len2 = self->content_len + len;
+	if(xml_istream_contentResize(self, len2 + 1) == 0)
+	{
+		self->error = 1;
+		return;
+	}
+
+	char* dst = &(self->content_buf[self->content_len]);
+	memcpy(dst, content, len);
+	self->content_buf[len2] = '\0';
+	self->content_len       = len2;
+
+	if(self->stats && (len2 > self->stats->peak_buffer))
+	{
+		self->stats->peak_buffer = len2;
+	}
+}
+
+static int xml_istream_parserReset(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	// XML_ParserReset clears the handlers and user data
+	// but keeps the parser memory for the next document
+	if(XML_ParserReset(self->parser, "UTF-8") == XML_FALSE)
+	{
+		LOGE("XML_ParserReset failed");
+		return 0;
+	}
+	XML_SetUserData(self->parser, (void*) self);
+	XML_SetElementHandler(self->parser,
+	                      xml_istream_start,
+	                      xml_istream_end);
+	XML_SetCharacterDataHandler(self->parser,
+	                            self->subs_count ? NULL :
+	                            xml_istream_content);
+	self->fed = 0;
+
+	return 1;
+}
+
+static int
+xml_istream_parseGzFile(xml_istream_t* self,
+                        gzFile f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	if(len <= 0)
+	{
+		LOGE("invalid len=%i", (int) len);
+		return 0;
+	}
+
+	// parse file
+	int    done  = 0;
+	size_t part  = 0;
+	size_t total = len;
+	while(done == 0)
+	{
+		void* buf = XML_GetBuffer(self->parser, 4096);
+		if(buf == NULL)
+		{
+			LOGE("XML_GetBuffer buf=NULL");
+			return 0;
+		}
+
+		double t0    = xml_istream_statsTime(self);
+		int    bytes = gzread(f, buf, 4096);
+		xml_istream_statsIo(self, t0);
+		if((bytes == 0) && (gzeof(f) == 0))
+		{
+			LOGE("gzread failed");
+			return 0;
+		}
+
+		done  = (bytes == 0) ? 1 : 0;
+		part += bytes;
+		self->progress = (float) ((double) part / (double) total);
+		if(xml_istream_expatParseBuffer(self, bytes, done) == 0)
+		{
+			// callbacks may stop the parser early
+			if(self->stopped)
+			{
+				return self->error ? 0 : 1;
+			}
+
+			// make sure str is null terminated
+			char* str = (char*) buf;
+			str[(bytes > 0) ? (bytes - 1) : 0] = '\0';
+
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser);
+			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i, buf=%s",
+			     XML_ErrorString(e), line, bytes, str);
+			return 0;
+		}
+		else if(self->error)
+		{
+			return 0;
+		}
+	}
+
+	// succcess
+	return 1;
+}
+
+static int
+xml_istream_parseInflate(xml_istream_t* self,
+                         xml_inflate_t* inflate,
+                         size_t part, size_t total)
+{
+	ASSERT(self);
+	ASSERT(inflate);
+
+	// parse file
+	int done = 0;
+	while(done == 0)
+	{
+		void* buf = XML_GetBuffer(self->parser, 4096);
+		if(buf == NULL)
+		{
+			LOGE("XML_GetBuffer buf=NULL");
+			return 0;
+		}
+
+		double t0    = xml_istream_statsTime(self);
+		int    bytes = xml_inflate_read(inflate, buf, 4096);
+		xml_istream_statsIo(self, t0);
+		if(bytes < 0)
+		{
+			return 0;
+		}
+
+		done  = (bytes == 0) ? 1 : 0;
+		part += bytes;
+		self->progress = (total == 0) ? 1.0f :
+		                 (float) ((double) part / (double) total);
+		if(xml_istream_expatParseBuffer(self, bytes, done) == 0)
+		{
+			// callbacks may stop the parser early
+			if(self->stopped)
+			{
+				return self->error ? 0 : 1;
+			}
+
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser) +
+			           self->line_offset;
+			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i",
+			     XML_ErrorString(e), line, bytes);
+			return 0;
+		}
+		else if(self->error)
+		{
+			return 0;
+		}
+	}
+
+	// succcess
+	return 1;
+}
+
+static int
+xml_istream_parseCheckpointGz(xml_istream_t* self,
+                              const char* gzname,
+                              const xml_istreamCheckpoint_t* ck,
+                              const char* names,
+                              const xml_inflatePoint_t* point,
+                              size_t len)
+{
+	ASSERT(self);
+	ASSERT(gzname);
+
+	// ck, names and point are NULL when starting from the
+	// beginning of the file
+
+	xml_inflate_t* inflate = xml_inflate_new(gzname);
+	if(inflate == NULL)
+	{
+		return 0;
+	}
+	xml_inflate_span(inflate,
+	                 (int64_t) self->checkpoint_interval);
+
+	size_t part = 0;
+	if(ck)
+	{
+		if(xml_inflate_seek(inflate, point, ck->offset) == 0)
+		{
+			goto fail_parse;
+		}
+		part = (size_t) ck->offset;
+	}
+
+	self->checkpoint_inflate = inflate;
+	if((ck && (xml_istream_checkpointRestore(self, ck,
+	                                         names) == 0)) ||
+	   (xml_istream_parseInflate(self, inflate, part,
+	                             len) == 0))
+	{
+		goto fail_parse;
+	}
+	self->checkpoint_inflate = NULL;
+
+	xml_inflate_delete(&inflate);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		self->checkpoint_inflate = NULL;
+		xml_inflate_delete(&inflate);
+	return 0;
+}
+
+static int xml_istream_format(const unsigned char* magic,
+                              size_t len)
+{
+	ASSERT(magic);
+
+	if((len >= 2) && (magic[0] == 0x1F) && (magic[1] == 0x8B))
+	{
+		return XML_ISTREAM_FORMAT_GZ;
+	}
+	else if(len < 4)
+	{
+		return XML_ISTREAM_FORMAT_XML;
+	}
+
+	// zstd frames may be preceded by skippable frames
+	unsigned int m = ((unsigned int) magic[0])       |
+	                 ((unsigned int) magic[1] << 8)  |
+	                 ((unsigned int) magic[2] << 16) |
+	                 ((unsigned int) magic[3] << 24);
+	if((m == 0xFD2FB528) || ((m & 0xFFFFFFF0) == 0x184D2A50))
+	{
+		return XML_ISTREAM_FORMAT_ZSTD;
+	}
+	else if(m == 0x184D2204)
+	{
+		return XML_ISTREAM_FORMAT_LZ4;
+	}
+
+	return XML_ISTREAM_FORMAT_XML;
+}
+
+#if defined(XML_ISTREAM_ZSTD) || defined(XML_ISTREAM_LZ4)
+static FILE* xml_istream_fopen(const char* fname, size_t* _len)
+{
+	ASSERT(fname);
+	ASSERT(_len);
+
+	FILE* f = fopen(fname, "rb");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", fname);
+		return NULL;
+	}
+
+	// the compressed len is used for progress
+	*_len = 0;
+	if(fseek(f, (long) 0, SEEK_END) == 0)
+	{
+		long pos = ftell(f);
+		*_len = (pos > 0) ? (size_t) pos : 0;
+	}
+
+	if(fseek(f, 0, SEEK_SET) == -1)
+	{
+		LOGE("fseek_set fname=%s", fname);
+		fclose(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+static int
+xml_istream_parseStatus(xml_istream_t* self, int bytes,
+                        int final)
+{
+	ASSERT(self);
+
+	if(xml_istream_expatParseBuffer(self, bytes,
+	                                final) == XML_STATUS_ERROR)
+	{
+		// callbacks may stop the parser early
+		if(self->stopped)
+		{
+			return self->error ? 0 : 1;
+		}
+
+		enum XML_Error e = XML_GetErrorCode(self->parser);
+		int line = XML_GetCurrentLineNumber(self->parser) +
+		           self->line_offset;
+		LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i",
+		     XML_ErrorString(e), line, bytes);
+		return 0;
+	}
+
+	return self->error ? 0 : 1;
+}
+#endif
+
+#ifdef XML_ISTREAM_ZSTD
+static int
+xml_istream_parseZstdFile(xml_istream_t* self,
+                          FILE* f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	ZSTD_DCtx* dctx = ZSTD_createDCtx();
+	if(dctx == NULL)
+	{
+		LOGE("ZSTD_createDCtx failed");
+		return 0;
+	}
+
+	size_t in_size  = ZSTD_DStreamInSize();
+	size_t out_size = ZSTD_DStreamOutSize();
+	void*  in_buf   = MALLOC(in_size);
+	if(in_buf == NULL)
+	{
+		LOGE("MALLOC failed");
+		goto fail_in_buf;
+	}
+
+	// decompress directly into the expat buffer where
+	// consecutive frames are decoded by the same stream
+	size_t part = 0;
+	size_t ret  = 0;
+	size_t bytes;
+	while((self->stopped == 0) &&
+	      ((bytes = fread(in_buf, 1, in_size, f)) > 0))
+	{
+		part += bytes;
+		self->progress = (len == 0) ? 0.0f :
+		                 (float) ((double) part / (double) len);
+
+		ZSTD_inBuffer input = { in_buf, bytes, 0 };
+		int full = 0;
+		while(((input.pos < input.size) || full) &&
+		      (self->stopped == 0))
+		{
+			void* buf = XML_GetBuffer(self->parser,
+			                          (int) out_size);
+			if(buf == NULL)
+			{
+				LOGE("XML_GetBuffer buf=NULL");
+				goto fail_parse;
+			}
+
+			ZSTD_outBuffer output = { buf, out_size, 0 };
+			double t0 = xml_istream_statsTime(self);
+			ret = ZSTD_decompressStream(dctx, &output, &input);
+			xml_istream_statsIo(self, t0);
+			if(ZSTD_isError(ret))
+			{
+				LOGE("ZSTD_decompressStream err=%s",
+				     ZSTD_getErrorName(ret));
+				goto fail_parse;
+			}
+
+			full = (output.pos == output.size) ? 1 : 0;
+			if(xml_istream_parseStatus(self, (int) output.pos,
+			                           0) == 0)
+			{
+				goto fail_parse;
+			}
+		}
+	}
+
+	// the remaining input is ignored after a stop
+	if((self->stopped == 0) && ferror(f))
+	{
+		LOGE("fread failed");
+		goto fail_parse;
+	}
+	else if((self->stopped == 0) && (ret != 0))
+	{
+		LOGE("truncated zstd");
+		goto fail_parse;
+	}
+
+	if(xml_istream_parseStatus(self, 0, 1) == 0)
+	{
+		goto fail_parse;
+	}
+
+	FREE(in_buf);
+	ZSTD_freeDCtx(dctx);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		FREE(in_buf);
+	fail_in_buf:
+		ZSTD_freeDCtx(dctx);
+	return 0;
+}
+#endif
+
+#ifdef XML_ISTREAM_LZ4
+static int
+xml_istream_parseLz4File(xml_istream_t* self,
+                         FILE* f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	LZ4F_dctx* dctx = NULL;
+	LZ4F_errorCode_t err;
+	err = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+	if(LZ4F_isError(err))
+	{
+		LOGE("LZ4F_createDecompressionContext err=%s",
+		     LZ4F_getErrorName(err));
+		return 0;
+	}
+
+	size_t in_size = XML_ISTREAM_MMAP_SLICE;
+	char*  in_buf  = (char*) MALLOC(in_size);
+	if(in_buf == NULL)
+	{
+		LOGE("MALLOC failed");
+		goto fail_in_buf;
+	}
+
+	// decompress directly into the expat buffer where the
+	// context starts the next frame after each frame ends
+	size_t part = 0;
+	size_t ret  = 0;
+	size_t bytes;
+	while((self->stopped == 0) &&
+	      ((bytes = fread(in_buf, 1, in_size, f)) > 0))
+	{
+		part += bytes;
+		self->progress = (len == 0) ? 0.0f :
+		                 (float) ((double) part / (double) len);
+
+		size_t pos  = 0;
+		int    full = 0;
+		while(((pos < bytes) || full) && (self->stopped == 0))
+		{
+			void* buf = XML_GetBuffer(self->parser,
+			                          XML_ISTREAM_MMAP_SLICE);
+			if(buf == NULL)
+			{
+				LOGE("XML_GetBuffer buf=NULL");
+				goto fail_parse;
+			}
+
+			size_t dst_size = XML_ISTREAM_MMAP_SLICE;
+			size_t src_size = bytes - pos;
+			double t0       = xml_istream_statsTime(self);
+			ret = LZ4F_decompress(dctx, buf, &dst_size,
+			                      &in_buf[pos], &src_size, NULL);
+			xml_istream_statsIo(self, t0);
+			if(LZ4F_isError(ret))
+			{
+				LOGE("LZ4F_decompress err=%s",
+				     LZ4F_getErrorName(ret));
+				goto fail_parse;
+			}
+			pos += src_size;
+
+			full = (dst_size == XML_ISTREAM_MMAP_SLICE) ? 1 : 0;
+			if(xml_istream_parseStatus(self, (int) dst_size,
+			                           0) == 0)
+			{
+				goto fail_parse;
+			}
+		}
+	}
+
+	// the remaining input is ignored after a stop
+	if((self->stopped == 0) && ferror(f))
+	{
+		LOGE("fread failed");
+		goto fail_parse;
+	}
+	else if((self->stopped == 0) && (ret != 0))
+	{
+		LOGE("truncated lz4");
+		goto fail_parse;
+	}
+
+	if(xml_istream_parseStatus(self, 0, 1) == 0)
+	{
+		goto fail_parse;
+	}
+
+	FREE(in_buf);
+	LZ4F_freeDecompressionContext(dctx);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		FREE(in_buf);
+	fail_in_buf:
+		LZ4F_freeDecompressionContext(dctx);
+	return 0;
+}
+#endif
+
+typedef struct
+{
+	gzFile f;
+
+	// ring of inflated buffers
+	int     count;
+	size_t  size;
+	char**  bufs;
+	size_t* bytes;
+	int     head;
+	int     tail;
+	int     used;
+
+	// state
+	int eof;
+	int error;
+	int stop;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+} xml_istreamPipeline_t;
+
+static void* xml_istream_inflateThread(void* arg)
+{
+	ASSERT(arg);
+
+	xml_istreamPipeline_t* pipe = (xml_istreamPipeline_t*) arg;
+
+	while(1)
+	{
+		// wait for a free buffer
+		pthread_mutex_lock(&pipe->mutex);
+		while((pipe->used == pipe->count) && (pipe->stop == 0))
+		{
+			pthread_cond_wait(&pipe->cond, &pipe->mutex);
+		}
+		if(pipe->stop)
+		{
+			pthread_mutex_unlock(&pipe->mutex);
+			return NULL;
+		}
+		int head = pipe->head;
+		pthread_mutex_unlock(&pipe->mutex);
+
+		// fill the buffer outside of the lock
+		char*  buf   = pipe->bufs[head];
+		size_t bytes = 0;
+		int    eof   = 0;
+		int    error = 0;
+		while(bytes < pipe->size)
+		{
+			int n = gzread(pipe->f, &buf[bytes],
+			               (unsigned int) (pipe->size - bytes));
+			if(n < 0)
+			{
+				LOGE("gzread failed");
+				error = 1;
+				break;
+			}
+			else if(n == 0)
+			{
+				if(gzeof(pipe->f) == 0)
+				{
+					LOGE("gzread failed");
+					error = 1;
+				}
+				eof = 1;
+				break;
+			}
+			bytes += n;
+		}
+
+		// publish the buffer
+		pthread_mutex_lock(&pipe->mutex);
+		pipe->bytes[head] = bytes;
+		pipe->head        = (head + 1)%pipe->count;
+		pipe->used       += 1;
+		pipe->eof         = eof;
+		pipe->error       = error;
+		pthread_cond_broadcast(&pipe->cond);
+		pthread_mutex_unlock(&pipe->mutex);
+
+		if(eof || error)
+		{
+			return NULL;
+		}
+	}
+}
+
+static int
+xml_istream_parseGzPipeline(xml_istream_t* self,
+                            gzFile f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	if(len <= 0)
+	{
+		LOGE("invalid len=%i", (int) len);
+		return 0;
+	}
+
+	xml_istreamPipeline_t pipe;
+	memset(&pipe, 0, sizeof(xml_istreamPipeline_t));
+	pipe.f     = f;
+	pipe.count = self->pipeline_count;
+	pipe.size  = self->pipeline_size;
+
+	pipe.bufs = (char**) CALLOC(pipe.count, sizeof(char*));
+	if(pipe.bufs == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	pipe.bytes = (size_t*) CALLOC(pipe.count, sizeof(size_t));
+	if(pipe.bytes == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_bytes;
+	}
+
+	int i;
+	for(i = 0; i < pipe.count; ++i)
+	{
+		pipe.bufs[i] = (char*) MALLOC(pipe.size);
+		if(pipe.bufs[i] == NULL)
+		{
+			LOGE("MALLOC failed");
+			goto fail_bufs;
+		}
+	}
+
+	if(pthread_mutex_init(&pipe.mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	if(pthread_cond_init(&pipe.cond, NULL) != 0)
+	{
+		LOGE("pthread_cond_init failed");
+		goto fail_cond;
+	}
+
+	pthread_t thread;
+	if(pthread_create(&thread, NULL, xml_istream_inflateThread,
+	                  (void*) &pipe) != 0)
+	{
+		LOGE("pthread_create failed");
+		goto fail_thread;
+	}
+
+	// parse the inflated buffers in the same 4096 byte steps
+	// as xml_istream_parseGzFile to preserve the progress
+	int    ret   = 1;
+	int    done  = 0;
+	size_t part  = 0;
+	size_t total = len;
+	while(done == 0)
+	{
+		// wait for an inflated buffer
+		pthread_mutex_lock(&pipe.mutex);
+		while((pipe.used == 0) && (pipe.eof == 0) &&
+		      (pipe.error == 0))
+		{
+			pthread_cond_wait(&pipe.cond, &pipe.mutex);
+		}
+		if(pipe.error)
+		{
+			pthread_mutex_unlock(&pipe.mutex);
+			ret = 0;
+			break;
+		}
+		int    tail  = pipe.tail;
+		size_t bytes = pipe.used ? pipe.bytes[tail] : 0;
+		int    last  = ((pipe.used <= 1) && pipe.eof) ? 1 : 0;
+		pthread_mutex_unlock(&pipe.mutex);
+
+		// parse the buffer
+		const char* buf    = pipe.bufs[tail];
+		size_t      offset = 0;
+		do
+		{
+			size_t left = bytes - offset;
+			int    step = (int) ((left > 4096) ? 4096 : left);
+
+			done  = (last && ((offset + step) == bytes)) ? 1 : 0;
+			part += step;
+			self->progress = (float) ((double) part /
+			                          (double) total);
+			if(xml_istream_expatParse(self, &buf[offset],
+			                          step, done) == XML_STATUS_ERROR)
+			{
+				// callbacks may stop the parser early
+				if(self->stopped)
+				{
+					ret  = self->error ? 0 : 1;
+					done = 1;
+					break;
+				}
+
+				enum XML_Error e = XML_GetErrorCode(self->parser);
+				int line = XML_GetCurrentLineNumber(self->parser);
+				LOGE("XML_Parse err=%s, line=%i, bytes=%i",
+				     XML_ErrorString(e), line, step);
+				ret = 0;
+				break;
+			}
+			else if(self->error)
+			{
+				ret = 0;
+				break;
+			}
+
+			offset += step;
+		} while(offset < bytes);
+
+		if(ret == 0)
+		{
+			break;
+		}
+
+		// release the buffer
+		pthread_mutex_lock(&pipe.mutex);
+		if(pipe.used)
+		{
+			pipe.tail  = (tail + 1)%pipe.count;
+			pipe.used -= 1;
+		}
+		pthread_cond_broadcast(&pipe.cond);
+		pthread_mutex_unlock(&pipe.mutex);
+	}
+
+	// stop the inflate thread
+	pthread_mutex_lock(&pipe.mutex);
+	pipe.stop = 1;
+	pthread_cond_broadcast(&pipe.cond);
+	pthread_mutex_unlock(&pipe.mutex);
+	pthread_join(thread, NULL);
+
+	pthread_cond_destroy(&pipe.cond);
+	pthread_mutex_destroy(&pipe.mutex);
+	for(i = 0; i < pipe.count; ++i)
+	{
+		FREE(pipe.bufs[i]);
+	}
+	FREE(pipe.bytes);
+	FREE(pipe.bufs);
+
+	// success
+	return ret;
+
+	// failure
+	fail_thread:
+		pthread_cond_destroy(&pipe.cond);
+	fail_cond:
+		pthread_mutex_destroy(&pipe.mutex);
+	fail_mutex:
+	fail_bufs:
+		for(i = 0; i < pipe.count; ++i)
+		{
+			FREE(pipe.bufs[i]);
+		}
+		FREE(pipe.bytes);
+	fail_bytes:
+		FREE(pipe.bufs);
+	return 0;
+}
+
+static size_t
+xml_istream_countLines(const char* buffer, size_t len)
+{
+	ASSERT(buffer);
+
+	size_t      count = 0;
+	const char* end   = buffer + len;
+	while(buffer < end)
+	{
+		buffer = (const char*) memchr(buffer, '\n', end - buffer);
+		if(buffer == NULL)
+		{
+			break;
+		}
+		++count;
+		++buffer;
+	}
+	return count;
+}
+
+static int
+xml_istream_restart(xml_istream_t* self, int depth,
+                    int line, int64_t offset)
+{
+	ASSERT(self);
+
+	// the first depth open elements are reopened by a reset
+	// parser which continues at offset and discards the
+	// input buffered by a suspended parser
+	size_t len   = (depth < self->depth) ?
+	               self->checkpoint_stack[depth] :
+	               self->checkpoint_names_len;
+	char*  names = (char*) MALLOC(len + 1);
+	if(names == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+	memcpy(names, self->checkpoint_names, len);
+
+	if(xml_istream_parserReset(self) == 0)
+	{
+		goto fail_reset;
+	}
+
+	int i;
+	for(i = 0; i < self->subs_count; ++i)
+	{
+		self->subs[i].matched = 0;
+	}
+	self->subs_depth           = 0;
+	self->depth                = 0;
+	self->checkpoint_names_len = 0;
+
+	int64_t prefix;
+	if(xml_istream_reopen(self, names, depth, line,
+	                      &prefix) == 0)
+	{
+		goto fail_reopen;
+	}
+	self->checkpoint_base = offset - prefix;
+
+	// the content of a skipped subtree is not buffered
+	if(self->skip_depth)
+	{
+		XML_SetCharacterDataHandler(self->parser, NULL);
+	}
+
+	FREE(names);
+
+	// success
+	return 1;
+
+	// failure
+	fail_reopen:
+	fail_reset:
+		FREE(names);
+	return 0;
+}
+
+static int
+xml_istream_skipRestart(xml_istream_t* self,
+                        const char* buffer,
+                        size_t start, size_t close)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	// the ancestors of the skipped element are reopened
+	// after the end tag
+	int depth = self->skip_depth - 1;
+	int line  = self->skip_line +
+	            (int) xml_istream_countLines(&buffer[start],
+	                                         close - start);
+	int64_t offset = self->checkpoint_base + self->skip_index +
+	                 (int64_t) (close - start);
+
+	self->content_len  = 0;
+	self->skip_depth   = 0;
+	self->skip_pending = 0;
+	return xml_istream_restart(self, depth, line, offset);
+}
+
+static void xml_istream_scanDelete(xml_istreamScan_t** _scan)
+{
+	ASSERT(_scan);
+
+	xml_istreamScan_t* scan = *_scan;
+	if(scan)
+	{
+		FREE(scan->buf);
+		FREE(scan->attrs);
+		FREE(scan->atts);
+		FREE(scan);
+		*_scan = NULL;
+	}
+}
+
+static int xml_istream_scanSpace(char c)
+{
+	// carriage returns are outside of the subset since
+	// expat normalizes line endings
+	return ((c == ' ') || (c == '\t') || (c == '\n')) ? 1 : 0;
+}
+
+static int xml_istream_scanNameStart(char c)
+{
+	// names outside of ASCII are handled by expat
+	return (((c >= 'a') && (c <= 'z')) ||
+	        ((c >= 'A') && (c <= 'Z')) ||
+	        (c == '_') || (c == ':')) ? 1 : 0;
+}
+
+static int xml_istream_scanName(char c)
+{
+	return (xml_istream_scanNameStart(c) ||
+	        ((c >= '0') && (c <= '9')) ||
+	        (c == '-') || (c == '.')) ? 1 : 0;
+}
+
+static const char*
+xml_istream_scanUtf8(const char* p, const char* end)
+{
+	ASSERT(p);
+	ASSERT(end);
+
+	// find the end of the run of multibyte sequences which
+	// are well-formed UTF-8 and XML characters where
+	// overlong forms, surrogates, U+FFFE and U+FFFF are
+	// rejected
+	while(p < end)
+	{
+		const unsigned char* u = (const unsigned char*) p;
+		size_t       left = (size_t) (end - p);
+		unsigned int c;
+		if((u[0] >= 0xC2) && (u[0] <= 0xDF))
+		{
+			if((left < 2) || ((u[1] & 0xC0) != 0x80))
+			{
+				break;
+			}
+			p += 2;
+		}
+		else if((u[0] >= 0xE0) && (u[0] <= 0xEF))
+		{
+			if((left < 3) || ((u[1] & 0xC0) != 0x80) ||
+			   ((u[2] & 0xC0) != 0x80))
+			{
+				break;
+			}
+
+			c = ((u[0] & 0x0F) << 12) | ((u[1] & 0x3F) << 6) |
+			    (u[2] & 0x3F);
+			if((c < 0x800) || ((c >= 0xD800) && (c <= 0xDFFF)) ||
+			   (c >= 0xFFFE))
+			{
+				break;
+			}
+			p += 3;
+		}
+		else if((u[0] >= 0xF0) && (u[0] <= 0xF4))
+		{
+			if((left < 4) || ((u[1] & 0xC0) != 0x80) ||
+			   ((u[2] & 0xC0) != 0x80) ||
+			   ((u[3] & 0xC0) != 0x80))
+			{
+				break;
+			}
+
+			c = ((u[0] & 0x07) << 18) | ((u[1] & 0x3F) << 12) |
+			    ((u[2] & 0x3F) << 6) | (u[3] & 0x3F);
+			if((c < 0x10000) || (c > 0x10FFFF))
+			{
+				break;
+			}
+			p += 4;
+		}
+		else
+		{
+			// ASCII or an invalid lead byte
+			break;
+		}
+	}
+
+	return p;
+}
+
+static int xml_istream_scanChars(const char* p, const char* end)
+{
+	ASSERT(p);
+	ASSERT(end);
+
+	// check that comments and processing instructions only
+	// contain XML characters within the subset
+	while(p < end)
+	{
+		unsigned char c = (unsigned char) *p;
+		if(c >= 0x80)
+		{
+			const char* q = xml_istream_scanUtf8(p, end);
+			if(q == p)
+			{
+				return 0;
+			}
+			p = q;
+			continue;
+		}
+		else if((c < 0x20) && (c != '\t') && (c != '\n'))
+		{
+			return 0;
+		}
+		++p;
+	}
+
+	return 1;
+}
+
+static const char*
+xml_istream_scanText(const char* p, const char* end,
+                     int* _lines)
+{
+	ASSERT(p);
+	ASSERT(end);
+	ASSERT(_lines);
+
+	// find the first '<', '&', '>', control character
+	// other than tab and newline or non-ASCII byte and
+	// count the lines before it where SSE2 compares 16
+	// bytes at once
+	int lines = 0;
+	#ifdef __SSE2__
+		const __m128i lt  = _mm_set1_epi8('<');
+		const __m128i gt  = _mm_set1_epi8('>');
+		const __m128i amp = _mm_set1_epi8('&');
+		const __m128i sp  = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i lf  = _mm_set1_epi8('\n');
+		while((end - p) >= 16)
+		{
+			// the signed compare with ' ' matches the control
+			// characters and the non-ASCII bytes
+			__m128i v    = _mm_loadu_si128((const __m128i*) p);
+			__m128i n    = _mm_cmpeq_epi8(v, lf);
+			__m128i ws   = _mm_or_si128(n, _mm_cmpeq_epi8(v, tab));
+			__m128i m    = _mm_andnot_si128(ws, _mm_cmplt_epi8(v, sp));
+			m            = _mm_or_si128(m, _mm_cmpeq_epi8(v, lt));
+			m            = _mm_or_si128(m, _mm_cmpeq_epi8(v, amp));
+			m            = _mm_or_si128(m, _mm_cmpeq_epi8(v, gt));
+			int     mask = _mm_movemask_epi8(m);
+			int     nl   = _mm_movemask_epi8(n);
+			if(mask)
+			{
+				int i = __builtin_ctz(mask);
+				lines += __builtin_popcount(nl & ((1 << i) - 1));
+				*_lines += lines;
+				return p + i;
+			}
+			lines += __builtin_popcount(nl);
+			p     += 16;
+		}
+	#endif
+
+	while(p < end)
+	{
+		unsigned char c = (unsigned char) *p;
+		if((c == '<') || (c == '&') || (c == '>') ||
+		   ((c < 0x20) && (c != '\t') && (c != '\n')) ||
+		   (c >= 0x80))
+		{
+			break;
+		}
+		else if(c == '\n')
+		{
+			++lines;
+		}
+		++p;
+	}
+
+	*_lines += lines;
+	return p;
+}
+
+static int
+xml_istream_scanEntity(const char* p, const char* end,
+                       char* out, int* _len,
+                       const char** _next)
+{
+	ASSERT(p);
+	ASSERT(end);
+	ASSERT(out);
+	ASSERT(_len);
+	ASSERT(_next);
+
+	// the predefined entities and character references are
+	// the only references without a DTD
+	const char* q = p + 1;
+	while((q < end) && (*q != ';') && ((q - p) < 12))
+	{
+		++q;
+	}
+	if((q == end) || (*q != ';'))
+	{
+		return 0;
+	}
+	*_next = q + 1;
+
+	const char* ref = p + 1;
+	size_t      n   = (size_t) (q - ref);
+	if((n == 2) && (memcmp(ref, "lt", 2) == 0))
+	{
+		out[0] = '<';
+		*_len  = 1;
+		return 1;
+	}
+	else if((n == 2) && (memcmp(ref, "gt", 2) == 0))
+	{
+		out[0] = '>';
+		*_len  = 1;
+		return 1;
+	}
+	else if((n == 3) && (memcmp(ref, "amp", 3) == 0))
+	{
+		out[0] = '&';
+		*_len  = 1;
+		return 1;
+	}
+	else if((n == 4) && (memcmp(ref, "quot", 4) == 0))
+	{
+		out[0] = '"';
+		*_len  = 1;
+		return 1;
+	}
+	else if((n == 4) && (memcmp(ref, "apos", 4) == 0))
+	{
+		out[0] = '\'';
+		*_len  = 1;
+		return 1;
+	}
+	else if((n < 2) || (ref[0] != '#'))
+	{
+		return 0;
+	}
+
+	unsigned int c   = 0;
+	int          hex = (ref[1] == 'x') ? 1 : 0;
+	size_t       i;
+	if(hex && (n == 2))
+	{
+		return 0;
+	}
+	for(i = 1 + hex; i < n; ++i)
+	{
+		char d = ref[i];
+		if((d >= '0') && (d <= '9'))
+		{
+			c = (hex ? 16 : 10)*c + (d - '0');
+		}
+		else if(hex && (d >= 'a') && (d <= 'f'))
+		{
+			c = 16*c + (d - 'a' + 10);
+		}
+		else if(hex && (d >= 'A') && (d <= 'F'))
+		{
+			c = 16*c + (d - 'A' + 10);
+		}
+		else
+		{
+			return 0;
+		}
+
+		if(c > 0x10FFFF)
+		{
+			return 0;
+		}
+	}
+
+	// encode the XML characters as UTF-8
+	if((c == 0x9) || (c == 0xA) || (c == 0xD) ||
+	   ((c >= 0x20) && (c < 0x80)))
+	{
+		out[0] = (char) c;
+		*_len  = 1;
+	}
+	else if((c >= 0x80) && (c < 0x800))
+	{
+		out[0] = (char) (0xC0 | (c >> 6));
+		out[1] = (char) (0x80 | (c & 0x3F));
+		*_len  = 2;
+	}
+	else if(((c >= 0x800) && (c <= 0xD7FF)) ||
+	        ((c >= 0xE000) && (c <= 0xFFFD)))
+	{
+		out[0] = (char) (0xE0 | (c >> 12));
+		out[1] = (char) (0x80 | ((c >> 6) & 0x3F));
+		out[2] = (char) (0x80 | (c & 0x3F));
+		*_len  = 3;
+	}
+	else if(c >= 0x10000)
+	{
+		out[0] = (char) (0xF0 | (c >> 18));
+		out[1] = (char) (0x80 | ((c >> 12) & 0x3F));
+		out[2] = (char) (0x80 | ((c >> 6) & 0x3F));
+		out[3] = (char) (0x80 | (c & 0x3F));
+		*_len  = 4;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+xml_istream_scanValue(const char* p, size_t len, char* dst)
+{
+	ASSERT(p);
+	ASSERT(dst);
+
+	// decode an attribute value where whitespace is
+	// normalized to spaces and the decoded value is not
+	// longer than the raw value
+	const char* end = p + len;
+	while(p < end)
+	{
+		unsigned char c = (unsigned char) *p;
+		if(c == '&')
+		{
+			int n;
+			if(xml_istream_scanEntity(p, end, dst, &n,
+			                          &p) == 0)
+			{
+				return 0;
+			}
+			dst += n;
+			continue;
+		}
+		else if(c >= 0x80)
+		{
+			const char* q = xml_istream_scanUtf8(p, end);
+			if(q == p)
+			{
+				return 0;
+			}
+			memcpy(dst, p, (size_t) (q - p));
+			dst += q - p;
+			p    = q;
+			continue;
+		}
+		else if((c == '<') ||
+		        ((c < 0x20) && (c != '\t') && (c != '\n')))
+		{
+			return 0;
+		}
+		else if((c == '\t') || (c == '\n'))
+		{
+			c = ' ';
+		}
+		*dst++ = (char) c;
+		++p;
+	}
+	*dst = '\0';
+
+	return 1;
+}
+
+static int
+xml_istream_scanStart(xml_istream_t* self,
+                      const char* p, const char* end,
+                      const char** _next, int* _empty)
+{
+	ASSERT(self);
+	ASSERT(p);
+	ASSERT(end);
+	ASSERT(_next);
+	ASSERT(_empty);
+
+	xml_istreamScan_t* scan = self->scan;
+
+	// find the spans of the name and attributes
+	const char* tag = p;
+	const char* q   = p + 1;
+	while((q < end) && xml_istream_scanName(*q))
+	{
+		++q;
+	}
+	size_t name_len = (size_t) (q - tag - 1);
+	size_t size     = name_len + 1;
+	int    natts    = 0;
+	while(1)
+	{
+		int space = 0;
+		while((q < end) && xml_istream_scanSpace(*q))
+		{
+			space = 1;
+			++q;
+		}
+
+		if(q == end)
+		{
+			return 0;
+		}
+		else if(*q == '>')
+		{
+			*_empty = 0;
+			++q;
+			break;
+		}
+		else if(*q == '/')
+		{
+			if(((q + 1) == end) || (q[1] != '>'))
+			{
+				return 0;
+			}
+			*_empty = 1;
+			q += 2;
+			break;
+		}
+		else if((space == 0) || (xml_istream_scanNameStart(*q) == 0))
+		{
+			return 0;
+		}
+
+		const char* att = q;
+		while((q < end) && xml_istream_scanName(*q))
+		{
+			++q;
+		}
+		size_t att_len = (size_t) (q - att);
+
+		while((q < end) && xml_istream_scanSpace(*q))
+		{
+			++q;
+		}
+		if((q == end) || (*q != '='))
+		{
+			return 0;
+		}
+		++q;
+		while((q < end) && xml_istream_scanSpace(*q))
+		{
+			++q;
+		}
+		if((q == end) || ((*q != '"') && (*q != '\'')))
+		{
+			return 0;
+		}
+
+		const char* value = q + 1;
+		q = (const char*) memchr(value, *q, end - value);
+		if(q == NULL)
+		{
+			return 0;
+		}
+		size_t value_len = (size_t) (q - value);
+		++q;
+
+		// expat reports duplicate attributes as errors
+		int i;
+		for(i = 0; i < natts; ++i)
+		{
+			xml_istreamScanAttr_t* a = &scan->attrs[i];
+			if((a->name_len == att_len) &&
+			   (memcmp(&tag[a->name], att, att_len) == 0))
+			{
+				return 0;
+			}
+		}
+
+		if(natts == scan->attrs_size)
+		{
+			int asize = scan->attrs_size ?
+			            2*scan->attrs_size : 16;
+
+			xml_istreamScanAttr_t* attrs;
+			attrs = (xml_istreamScanAttr_t*)
+			        REALLOC(scan->attrs,
+			                asize*sizeof(xml_istreamScanAttr_t));
+			if(attrs == NULL)
+			{
+				LOGE("REALLOC failed");
+				self->error = 1;
+				return 0;
+			}
+			scan->attrs      = attrs;
+			scan->attrs_size = asize;
+		}
+
+		xml_istreamScanAttr_t* a = &scan->attrs[natts++];
+		a->name      = (size_t) (att - tag);
+		a->name_len  = att_len;
+		a->value     = (size_t) (value - tag);
+		a->value_len = value_len;
+		size        += att_len + value_len + 2;
+	}
+
+	// copy the name and decode the attributes
+	if(size > scan->buf_size)
+	{
+		size_t bsize = scan->buf_size ? scan->buf_size : 256;
+		while(bsize < size)
+		{
+			bsize *= 2;
+		}
+
+		char* buf = (char*) REALLOC(scan->buf, bsize);
+		if(buf == NULL)
+		{
+			LOGE("REALLOC failed");
+			self->error = 1;
+			return 0;
+		}
+		scan->buf      = buf;
+		scan->buf_size = bsize;
+	}
+
+	if(2*natts + 1 > scan->atts_size)
+	{
+		int asize = 2*natts + 1;
+
+		const char** atts;
+		atts = (const char**)
+		       REALLOC(scan->atts, asize*sizeof(const char*));
+		if(atts == NULL)
+		{
+			LOGE("REALLOC failed");
+			self->error = 1;
+			return 0;
+		}
+		scan->atts      = atts;
+		scan->atts_size = asize;
+	}
+
+	char* dst = scan->buf;
+	memcpy(dst, tag + 1, name_len);
+	dst[name_len] = '\0';
+	dst += name_len + 1;
+
+	int i;
+	for(i = 0; i < natts; ++i)
+	{
+		xml_istreamScanAttr_t* a = &scan->attrs[i];
+		memcpy(dst, &tag[a->name], a->name_len);
+		dst[a->name_len]    = '\0';
+		scan->atts[2*i]     = dst;
+		dst                += a->name_len + 1;
+		scan->atts[2*i + 1] = dst;
+		if(xml_istream_scanValue(&tag[a->value], a->value_len,
+		                         dst) == 0)
+		{
+			return 0;
+		}
+		dst += strlen(dst) + 1;
+	}
+	scan->atts[2*natts] = NULL;
+
+	*_next = q;
+	return 1;
+}
+
+static int
+xml_istream_scanDecl(const char* p, const char* end,
+                     const char** _next)
+{
+	ASSERT(p);
+	ASSERT(end);
+	ASSERT(_next);
+
+	// the XML declaration must not declare an encoding
+	// other than UTF-8 (or its ASCII subset)
+	const char* q = xml_istream_skipFind(p, end, "?>", 2);
+	if(q == NULL)
+	{
+		return 0;
+	}
+	*_next = q;
+
+	const char* enc = xml_istream_skipFind(p, q, "encoding", 8);
+	if(enc == NULL)
+	{
+		return 1;
+	}
+
+	// find the quoted encoding name
+	while((enc < q) && (*enc != '"') && (*enc != '\''))
+	{
+		++enc;
+	}
+	if(enc == q)
+	{
+		return 0;
+	}
+
+	const char* name = enc + 1;
+	const char* quote;
+	quote = (const char*) memchr(name, *enc, q - name);
+	if(quote == NULL)
+	{
+		return 0;
+	}
+
+	size_t len = (size_t) (quote - name);
+	if(((len == 5) && (strncasecmp(name, "UTF-8", 5) == 0)) ||
+	   ((len == 8) && (strncasecmp(name, "US-ASCII", 8) == 0)))
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+xml_istream_scanRange(xml_istream_t* self,
+                      const char* buffer,
+                      size_t* _offset, size_t end,
+                      size_t total, size_t slice,
+                      int* _done)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+	ASSERT(_offset);
+	ASSERT(_done);
+
+	xml_istreamScan_t* scan = self->scan;
+
+	// the scanner delivers the events through the expat
+	// handlers until the end of the document or the first
+	// construct which is outside of the subset where the
+	// open elements are reopened by expat
+	size_t      start = *_offset;
+	const char* p     = &buffer[start];
+	const char* e     = &buffer[end];
+	const char* bound = p;
+	int         line  = 1;
+	int         root  = 0;
+
+	*_done = 0;
+
+	// skip the byte order mark and XML declaration
+	if(((e - p) >= 3) && (memcmp(p, "\xEF\xBB\xBF", 3) == 0))
+	{
+		p += 3;
+	}
+	if(((e - p) >= 6) && (memcmp(p, "<?xml", 5) == 0) &&
+	   xml_istream_scanSpace(p[5]))
+	{
+		const char* q;
+		if((xml_istream_scanDecl(p, e, &q) == 0) ||
+		   (xml_istream_scanChars(p, q) == 0))
+		{
+			return 1;
+		}
+		line += (int) xml_istream_countLines(p, q - p);
+		p     = q;
+	}
+
+	// progress is updated at slice boundaries
+	double nested   = xml_istream_statsNested(self);
+	double t0       = xml_istream_statsTime(self);
+	size_t last     = start;
+	size_t next     = start + slice;
+	int    timed    = (self->stats || self->progress_fn) ? 1 : 0;
+	int    finished = 0;
+
+	scan->active = 1;
+	while(p < e)
+	{
+		size_t pos = (size_t) (p - buffer);
+		if(pos >= next)
+		{
+			self->progress = (float) ((double) pos /
+			                          (double) total);
+			if(timed)
+			{
+				xml_istream_statsParse(self, t0, nested,
+				                       (int) (pos - last));
+				nested = xml_istream_statsNested(self);
+				t0     = xml_stats_time();
+			}
+			last = pos;
+			next = pos + slice;
+
+			if(self->error)
+			{
+				finished = 1;
+				break;
+			}
+		}
+
+		// character data and references
+		if(*p != '<')
+		{
+			const char* text  = p;
+			int         lines = 0;
+
+			// '>' is only allowed in character data when it
+			// does not end the sequence ']]>' and non-ASCII
+			// characters must be valid UTF-8
+			const char* r = text;
+			while(1)
+			{
+				p = xml_istream_scanText(r, e, &lines);
+				if((p < e) && ((unsigned char) *p >= 0x80))
+				{
+					r = xml_istream_scanUtf8(p, e);
+					if(r == p)
+					{
+						break;
+					}
+					continue;
+				}
+				else if((p == e) || (*p != '>') ||
+				        (((p - text) >= 2) &&
+				         (p[-1] == ']') && (p[-2] == ']')))
+				{
+					break;
+				}
+				r = p + 1;
+			}
+
+			if((p < e) && (*p == '>'))
+			{
+				p = bound;
+				break;
+			}
+			else if(self->depth == 0)
+			{
+				// only whitespace is allowed outside of
+				// the root element
+				const char* q = text;
+				while((q < p) && xml_istream_scanSpace(*q))
+				{
+					++q;
+				}
+				if((q < p) || ((p < e) && (*p != '<')))
+				{
+					p = bound;
+					break;
+				}
+			}
+			else if((p > text) && (self->skip_depth == 0) &&
+			        ((self->subs_count == 0) || self->subs_depth))
+			{
+				xml_istream_content(self, text, (int) (p - text));
+			}
+			line  += lines;
+			bound  = p;
+
+			if((p < e) && (*p == '&'))
+			{
+				char ref[4];
+				int  n;
+				if(xml_istream_scanEntity(p, e, ref, &n,
+				                          &p) == 0)
+				{
+					break;
+				}
+				else if((self->skip_depth == 0) &&
+				        ((self->subs_count == 0) ||
+				         self->subs_depth))
+				{
+					xml_istream_content(self, ref, n);
+				}
+				bound = p;
+			}
+			else if((p < e) && (*p != '<'))
+			{
+				// control characters (including carriage
+				// returns) and invalid UTF-8 are handled by
+				// expat
+				break;
+			}
+
+			if(self->error)
+			{
+				finished = 1;
+				break;
+			}
+			continue;
+		}
+
+		if((e - p) < 2)
+		{
+			break;
+		}
+
+		const char* q = NULL;
+		if(p[1] == '/')
+		{
+			// end tags must match the open element
+			if(self->depth == 0)
+			{
+				break;
+			}
+
+			const char* name = &self->checkpoint_names[self->checkpoint_stack[self->depth - 1]];
+			size_t      len  = strlen(name);
+			q = p + 2;
+			if(((size_t) (e - q) < len) ||
+			   (memcmp(q, name, len) != 0))
+			{
+				break;
+			}
+			q += len;
+			while((q < e) && xml_istream_scanSpace(*q))
+			{
+				++q;
+			}
+			if((q == e) || (*q != '>'))
+			{
+				break;
+			}
+			++q;
+
+			scan->line   = line;
+			scan->offset = self->checkpoint_base +
+			               (int64_t) (q - &buffer[start]);
+			xml_istream_end(self, name);
+			line += (int) xml_istream_countLines(p, q - p);
+		}
+		else if(p[1] == '?')
+		{
+			// processing instructions are not reported but
+			// the XML declaration must be first
+			q = xml_istream_skipFind(p + 2, e, "?>", 2);
+			if((q == NULL) ||
+			   (((e - p) >= 6) &&
+			    (strncasecmp(p + 2, "xml", 3) == 0) &&
+			    (xml_istream_scanName(p[5]) == 0)) ||
+			   (xml_istream_scanChars(p, q) == 0))
+			{
+				break;
+			}
+			line += (int) xml_istream_countLines(p, q - p);
+		}
+		else if(((e - p) >= 4) && (memcmp(p, "<!--", 4) == 0))
+		{
+			// comments are not reported and must not
+			// contain "--"
+			q = xml_istream_skipFind(p + 4, e, "--", 2);
+			if((q == NULL) || (q == e) || (*q != '>') ||
+			   (xml_istream_scanChars(p, q) == 0))
+			{
+				break;
+			}
+			++q;
+			line += (int) xml_istream_countLines(p, q - p);
+		}
+		else if(xml_istream_scanNameStart(p[1]))
+		{
+			// the root element must be the only element at
+			// the top level
+			if((self->depth == 0) && root)
+			{
+				break;
+			}
+
+			int empty;
+			if(xml_istream_scanStart(self, p, e, &q,
+			                         &empty) == 0)
+			{
+				finished = self->error;
+				break;
+			}
+			root = 1;
+
+			const char* name = scan->buf;
+			scan->line   = line;
+			scan->offset = self->checkpoint_base +
+			               (int64_t) (q - &buffer[start]);
+			xml_istream_start(self, name, scan->atts);
+			if(self->error || self->stopped)
+			{
+				p        = q;
+				finished = 1;
+				break;
+			}
+
+			if(empty)
+			{
+				// expat reports the end of an empty element
+				// at the end of the tag
+				line += (int) xml_istream_countLines(p, q - p);
+				scan->line = line;
+				xml_istream_end(self, name);
+			}
+			else if(self->skip_depth == self->depth)
+			{
+				// fast-forward the skipped subtree
+				size_t close;
+				if(xml_istream_skipScan(buffer, pos, end,
+				                        &close) == 0)
+				{
+					line += (int) xml_istream_countLines(p,
+					                                     q - p);
+					p     = q;
+					bound = p;
+					break;
+				}
+				line += (int) xml_istream_countLines(p,
+				                                     close - pos);
+				q = &buffer[close];
+				scan->line   = line;
+				scan->offset = self->checkpoint_base +
+				               (int64_t) (close - start);
+				xml_istream_end(self, name);
+			}
+			else
+			{
+				line += (int) xml_istream_countLines(p, q - p);
+			}
+		}
+		else
+		{
+			// CDATA sections and declarations
+			break;
+		}
+
+		p     = q;
+		bound = p;
+		if(self->error || self->stopped || self->doc_done)
+		{
+			finished = 1;
+			break;
+		}
+	}
+
+	if(timed)
+	{
+		xml_istream_statsParse(self, t0, nested,
+		                       (int) ((size_t) (p - buffer) - last));
+	}
+	scan->active = 0;
+
+	// callbacks may stop the parse and the end handler
+	// stops at the end of concatenated documents
+	if(finished)
+	{
+		*_offset = (size_t) (p - buffer);
+		*_done   = 1;
+		return self->error ? 0 : 1;
+	}
+
+	// the document is complete when the root element was
+	// closed and the trailing input was consumed
+	if((p == e) && root && (self->depth == 0))
+	{
+		self->progress = 1.0f;
+		*_offset       = end;
+		*_done         = 1;
+		return 1;
+	}
+
+	// junk after the root element would start a new
+	// document in expat
+	if(root && (self->depth == 0))
+	{
+		LOGE("junk after document element line=%i", line);
+		return 0;
+	}
+
+	// reparse the document from the start when the
+	// prolog is outside of the subset
+	if(root == 0)
+	{
+		return 1;
+	}
+
+	// continue with expat at the last boundary
+	*_offset = (size_t) (bound - buffer);
+	return xml_istream_restart(self, self->depth, line,
+	                           self->checkpoint_base +
+	                           (int64_t) (*_offset - start));
+}
+
+static int
+xml_istream_parseRange(xml_istream_t* self,
+                       const char* buffer,
+                       size_t offset, size_t end,
+                       size_t total, size_t slice,
+                       int final)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	// the scanner parses new documents until the first
+	// construct outside of its subset
+	int done = 0;
+	if(self->scan && final && (self->fed == 0) &&
+	   (self->depth == 0))
+	{
+		if(xml_istream_scanRange(self, buffer, &offset, end,
+		                         total, slice, &done) == 0)
+		{
+			return 0;
+		}
+		else if(done)
+		{
+			return 1;
+		}
+	}
+
+	// parse memory in place which avoids the XML_GetBuffer
+	// copy since expat reads directly from the buffer
+	int ret = 1;
+	do
+	{
+		size_t left  = end - offset;
+		int    bytes = (int) ((left > slice) ? slice : left);
+
+		done = ((offset + bytes) == end) ? 1 : 0;
+		self->progress = (total == 0) ? 1.0f :
+		                 (float) ((double) (offset + bytes) /
+		                          (double) total);
+
+		int64_t fed = self->fed;
+		enum XML_Status status;
+		self->skip_end = &buffer[offset + bytes];
+		status = xml_istream_expatParse(self, &buffer[offset],
+		                                bytes, done && final);
+
+		// the start handler suspends the parser at a skipped
+		// subtree which is fast-forwarded when the matching
+		// end tag is found in the range
+		size_t start   = 0;
+		size_t close   = 0;
+		int    restart = 0;
+		while(status == XML_STATUS_SUSPENDED)
+		{
+			start = (size_t) ((int64_t) offset +
+			                  self->skip_index - fed);
+			if(self->skip_pending &&
+			   xml_istream_skipScan(buffer, start, end, &close))
+			{
+				restart = 1;
+				break;
+			}
+
+			self->skip_pending = 0;
+			status = xml_istream_expatResume(self);
+		}
+
+		if(restart)
+		{
+			if(xml_istream_skipRestart(self, buffer, start,
+			                           close) == 0)
+			{
+				ret = 0;
+				break;
+			}
+
+			// continue parsing after the end tag
+			offset = close;
+			done   = 0;
+			continue;
+		}
+		else if(status == XML_STATUS_ERROR)
+		{
+			// the end handler stops the parser at the end of
+			// concatenated documents and callbacks may stop
+			// the parser early
+			if(self->doc_done || self->stopped)
+			{
+				ret = self->error ? 0 : 1;
+				break;
+			}
+
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser) +
+			           self->line_offset;
+			LOGE("XML_Parse err=%s, line=%i, offset=%u, bytes=%i",
+			     XML_ErrorString(e), line, (unsigned int) offset,
+			     bytes);
+			ret = 0;
+			break;
+		}
+		else if(self->error)
+		{
+			ret = 0;
+			break;
+		}
+
+		offset += bytes;
+	} while(done == 0);
+
+	self->skip_end = NULL;
+	return ret;
+}
+
+static enum XML_Status
+xml_istream_pullParse(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	enum XML_Status status;
+	if(self->pull_file)
+	{
+		void* buf = XML_GetBuffer(self->parser, 4096);
+		if(buf == NULL)
+		{
+			LOGE("XML_GetBuffer buf=NULL");
+			self->error = 1;
+			return XML_STATUS_ERROR;
+		}
+
+		double t0    = xml_istream_statsTime(self);
+		size_t bytes = fread(buf, 1, 4096, self->pull_file);
+		xml_istream_statsIo(self, t0);
+		if(ferror(self->pull_file))
+		{
+			LOGE("fread failed");
+			self->error = 1;
+			return XML_STATUS_ERROR;
+		}
+
+		self->pull_offset += bytes;
+		if(self->pull_len)
+		{
+			self->progress = (float)
+			                 ((double) self->pull_offset /
+			                  (double) self->pull_len);
+		}
+
+		int final = (bytes < 4096) && feof(self->pull_file);
+		status = xml_istream_expatParseBuffer(self, (int) bytes,
+		                                      final);
+	}
+	else
+	{
+		size_t offset = self->pull_offset;
+		size_t left   = self->pull_len - offset;
+		int    bytes  = (int) ((left > 4096) ? 4096 : left);
+
+		self->pull_offset += bytes;
+		self->progress     = (self->pull_len == 0) ? 1.0f :
+		                     (float) ((double) self->pull_offset /
+		                              (double) self->pull_len);
+
+		int final = (self->pull_offset == self->pull_len);
+		status = xml_istream_expatParse(self,
+		                                &self->pull_buffer[offset],
+		                                bytes, final);
+	}
+
+	return status;
+}
+
+static int
+xml_istream_pushStatus(xml_istream_t* self,
+                       enum XML_Status status)
+{
+	ASSERT(self);
+
+	// the input after a callback stopped the parser is
+	// ignored
+	if(self->stopped)
+	{
+		return self->error ? XML_ISTREAM_FEED_ERROR :
+		                     XML_ISTREAM_FEED_OK;
+	}
+	else if(status == XML_STATUS_ERROR)
+	{
+		if(self->error == 0)
+		{
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser) +
+			           self->line_offset;
+			LOGE("XML_Parse err=%s, line=%i",
+			     XML_ErrorString(e), line);
+			self->error = 1;
+		}
+		return XML_ISTREAM_FEED_ERROR;
+	}
+	else if(self->error)
+	{
+		return XML_ISTREAM_FEED_ERROR;
+	}
+	else if(status == XML_STATUS_SUSPENDED)
+	{
+		self->push_suspended = 1;
+		return XML_ISTREAM_FEED_SUSPENDED;
+	}
+
+	return XML_ISTREAM_FEED_OK;
+}
+
+static int
+xml_istream_pushReady(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(self->push == 0)
+	{
+		LOGE("invalid push");
+		return 0;
+	}
+	else if(self->push_suspended)
+	{
+		LOGE("invalid suspended");
+		return 0;
+	}
+
+	return self->error ? 0 : 1;
+}
+
+struct xml_istreamParallel_s;
+
+typedef struct
+{
+	struct xml_istreamParallel_s* parallel;
+	xml_istream_t*                istream;
+	xml_istreamLog_t*             log;
+	xml_inflate_t*                inflate;
+
+	float progress;
+
+	pthread_t thread;
+} xml_istreamWorker_t;
+
+typedef struct xml_istreamParallel_s
+{
+	xml_istream_t* self;
+	const char*    buffer;
+	size_t         total;
+	size_t         slice;
+	int            ordered;
+
+	// gzip input is parsed with an index where the workers
+	// inflate their chunks from the access points
+	const char*          gzname;
+	const xml_gzindex_t* index;
+	xml_inflate_t*       inflate;
+
+	// chunks are wrapped by the root element so that records
+	// are parsed as siblings with the same paths
+	char root[256];
+	char begin[256];
+	char end[256];
+
+	// chunk boundaries and the newlines before each chunk
+	// where the prolog ends at the first bound and the tail
+	// starts at the last bound
+	// lines are counted by the workers when count_lines is
+	// set and reopen replaces the prolog by the root element
+	int     nchunks;
+	size_t* bounds;
+	int*    lines;
+	int     count_lines;
+	int     reopen;
+
+	// scheduler where stop is set once a callback stops the
+	// parse and is also read by the workers without the lock
+	int phase;
+	int next;
+	int replayed;
+	int error;
+	int stop;
+
+	// ordered logs
+	int               window;
+	xml_istreamLog_t* logs;
+	int*              done;
+
+	int                  nworkers;
+	xml_istreamWorker_t* workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+} xml_istreamParallel_t;
+
+// target chunk size for parallel parsing
+#define XML_ISTREAM_PARALLEL_CHUNK (4*1024*1024)
+
+
+static int
+xml_istream_parseGzRange(xml_istream_t* self,
+                         xml_inflate_t** _inflate,
+                         const char* gzname,
+                         const xml_gzindex_t* index,
+                         size_t offset, size_t end,
+                         size_t total, int final)
+{
+	ASSERT(self);
+	ASSERT(_inflate);
+	ASSERT(gzname);
+	ASSERT(index);
+
+	// open the inflate reader on demand and seek unless the
+	// previous range ended at the offset
+	xml_inflate_t* inflate = *_inflate;
+	if(inflate == NULL)
+	{
+		inflate = xml_inflate_new(gzname);
+		if(inflate == NULL)
+		{
+			return 0;
+		}
+		*_inflate = inflate;
+	}
+
+	if(inflate->out != (int64_t) offset)
+	{
+		const xml_inflatePoint_t* point;
+		point = xml_gzindex_point(index, (int64_t) offset);
+		if((point == NULL) ||
+		   (xml_inflate_seek(inflate, point,
+		                     (int64_t) offset) == 0))
+		{
+			return 0;
+		}
+	}
+
+	int done = 0;
+	do
+	{
+		size_t left  = end - offset;
+		int    bytes = (int) ((left > XML_ISTREAM_MMAP_SLICE) ?
+		                      XML_ISTREAM_MMAP_SLICE : left);
+
+		enum XML_Status status;
+		done = ((offset + bytes) == end) ? 1 : 0;
+		if(bytes)
+		{
+			void* buf = XML_GetBuffer(self->parser, bytes);
+			if(buf == NULL)
+			{
+				LOGE("XML_GetBuffer buf=NULL");
+				return 0;
+			}
+
+			double t0 = xml_istream_statsTime(self);
+			if(xml_inflate_read(inflate, buf, bytes) != bytes)
+			{
+				LOGE("invalid offset=%lli",
+				     (long long) inflate->out);
+				return 0;
+			}
+			xml_istream_statsIo(self, t0);
+
+			offset += bytes;
+			self->progress = (total == 0) ? 1.0f :
+			                 (float) ((double) offset /
+			                          (double) total);
+			status = xml_istream_expatParseBuffer(self, bytes,
+			                                      done && final);
+		}
+		else
+		{
+			status = xml_istream_expatParse(self, NULL, 0,
+			                                final);
+		}
+
+		if(status == XML_STATUS_ERROR)
+		{
+			// callbacks may stop the parser early
+			if(self->stopped)
+			{
+				return self->error ? 0 : 1;
+			}
+
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser) +
+			           self->line_offset;
+			LOGE("XML_ParseBuffer err=%s, line=%i, offset=%lli",
+			     XML_ErrorString(e), line, (long long) offset);
+			return 0;
+		}
+		else if(self->error)
+		{
+			return 0;
+		}
+	} while(done == 0);
+
+	return 1;
+}
+
+static int
+xml_istream_parallelRange(xml_istreamParallel_t* parallel,
+                          xml_istream_t* istream,
+                          xml_inflate_t** _inflate,
+                          size_t start, size_t end,
+                          int final)
+{
+	ASSERT(parallel);
+	ASSERT(istream);
+	ASSERT(_inflate);
+
+	if(parallel->index)
+	{
+		return xml_istream_parseGzRange(istream, _inflate,
+		                                parallel->gzname,
+		                                parallel->index,
+		                                start, end,
+		                                parallel->total, final);
+	}
+
+	return xml_istream_parseRange(istream, parallel->buffer,
+	                              start, end, parallel->total,
+	                              parallel->slice, final);
+}
+
+static int
+xml_istream_workerStart(void* priv, int line,
+                        float progress,
+                        const char* name,
+                        const char** atts)
+{
+	ASSERT(priv);
+	ASSERT(name);
+	ASSERT(atts);
+
+	xml_istreamWorker_t*   worker   = (xml_istreamWorker_t*) priv;
+	xml_istreamParallel_t* parallel = worker->parallel;
+
+	// skip the chunk wrapper
+	if(worker->istream->depth == 1)
+	{
+		return 1;
+	}
+
+	// the intern table is read-only on the worker threads
+	if(parallel->ordered == 0)
+	{
+		// another worker may have stopped the parse
+		if(__atomic_load_n(&parallel->stop, __ATOMIC_RELAXED))
+		{
+			return XML_ISTREAM_STOP;
+		}
+
+		xml_istream_t* self = parallel->self;
+		xml_istream_start_fn start_fn;
+		start_fn = xml_istream_startFn(self,
+		                               xml_istream_nameId(self,
+		                                                  name, 0));
+
+		// skip and stop are applied by the worker istream
+		int ret = (*start_fn)(self->priv, line, worker->progress,
+		                      name, atts);
+		if(ret == XML_ISTREAM_STOP)
+		{
+			__atomic_store_n(&parallel->stop, 1, __ATOMIC_RELAXED);
+		}
+		return ret;
+	}
+
+	if(xml_istream_logStart(worker->log, line,
+	                        name, atts) == NULL)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+xml_istream_workerEnd(void* priv, int line,
+                      float progress,
+                      const char* name,
+                      const char* content,
+                      size_t len)
+{
+	ASSERT(priv);
+	ASSERT(name);
+
+	xml_istreamWorker_t*   worker   = (xml_istreamWorker_t*) priv;
+	xml_istreamParallel_t* parallel = worker->parallel;
+
+	// skip the chunk wrapper
+	if(worker->istream->depth == 1)
+	{
+		return 1;
+	}
+
+	if(parallel->ordered == 0)
+	{
+		if(__atomic_load_n(&parallel->stop, __ATOMIC_RELAXED))
+		{
+			return XML_ISTREAM_STOP;
+		}
+
+		xml_istream_t* self = parallel->self;
+		xml_istream_end_fn end_fn;
+		end_fn = xml_istream_endFn(self,
+		                           xml_istream_nameId(self,
+		                                              name, 0));
+
+		int ret = (*end_fn)(self->priv, line, worker->progress,
+		                    name, content, len);
+		if(ret == XML_ISTREAM_STOP)
+		{
+			__atomic_store_n(&parallel->stop, 1, __ATOMIC_RELAXED);
+		}
+		return ret;
+	}
+
+	if(xml_istream_logEnd(worker->log, line, name,
+	                      content, len) == NULL)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+xml_istream_workerChunk(xml_istreamWorker_t* worker, int k)
+{
+	ASSERT(worker);
+
+	xml_istreamParallel_t* parallel = worker->parallel;
+	xml_istream_t*         istream  = worker->istream;
+
+	size_t start = parallel->bounds[k];
+	size_t end   = parallel->bounds[k + 1];
+
+	worker->progress = (float) ((double) end /
+	                            (double) parallel->total);
+
+	if(xml_istream_reset(istream) == 0)
+	{
+		return 0;
+	}
+	istream->line_offset = parallel->lines[k];
+
+	if((XML_Parse(istream->parser, parallel->begin,
+	              strlen(parallel->begin),
+	              0) == XML_STATUS_ERROR) ||
+	   (xml_istream_parallelRange(parallel, istream,
+	                              &worker->inflate,
+	                              start, end, 0) == 0))
+	{
+		LOGE("invalid chunk=%i, start=%u",
+		     k, (unsigned int) start);
+		return 0;
+	}
+
+	// a callback stopped the parse
+	if(istream->stopped)
+	{
+		return 1;
+	}
+
+	if(XML_Parse(istream->parser, parallel->end,
+	             strlen(parallel->end),
+	             1) == XML_STATUS_ERROR)
+	{
+		enum XML_Error e = XML_GetErrorCode(istream->parser);
+		LOGE("XML_Parse err=%s, chunk=%i, start=%u",
+		     XML_ErrorString(e), k, (unsigned int) start);
+		return 0;
+	}
+
+	return istream->error ? 0 : 1;
+}
+
+static void* xml_istream_workerThread(void* arg)
+{
+	ASSERT(arg);
+
+	xml_istreamWorker_t*   worker   = (xml_istreamWorker_t*) arg;
+	xml_istreamParallel_t* parallel = worker->parallel;
+
+	// count newlines per chunk which are converted to line
+	// offsets before the chunks are parsed
+	if(parallel->phase == 0)
+	{
+		while(1)
+		{
+			pthread_mutex_lock(&parallel->mutex);
+			int k = parallel->next++;
+			pthread_mutex_unlock(&parallel->mutex);
+			if(k >= parallel->nchunks)
+			{
+				return NULL;
+			}
+
+			size_t start = parallel->bounds[k];
+			size_t end   = parallel->bounds[k + 1];
+			parallel->lines[k] = (int)
+			                     xml_istream_countLines(&parallel->buffer[start],
+			                                            end - start);
+		}
+	}
+
+	while(1)
+	{
+		// claim the next chunk and bound the ordered logs to
+		// the window ahead of the replay
+		pthread_mutex_lock(&parallel->mutex);
+		while(parallel->ordered &&
+		      (parallel->error == 0) &&
+		      (__atomic_load_n(&parallel->stop,
+		                       __ATOMIC_RELAXED) == 0) &&
+		      (parallel->next < parallel->nchunks) &&
+		      (parallel->next >= (parallel->replayed +
+		                          parallel->window)))
+		{
+			pthread_cond_wait(&parallel->cond, &parallel->mutex);
+		}
+		int k = parallel->next;
+		if(parallel->error ||
+		   __atomic_load_n(&parallel->stop, __ATOMIC_RELAXED) ||
+		   (k >= parallel->nchunks))
+		{
+			pthread_mutex_unlock(&parallel->mutex);
+			return NULL;
+		}
+		parallel->next += 1;
+		pthread_mutex_unlock(&parallel->mutex);
+
+		int slot = k%parallel->window;
+		worker->log = &parallel->logs[slot];
+
+		int ret = xml_istream_workerChunk(worker, k);
+
+		pthread_mutex_lock(&parallel->mutex);
+		if(ret == 0)
+		{
+			parallel->error = 1;
+		}
+		parallel->done[slot] = k + 1;
+		pthread_cond_broadcast(&parallel->cond);
+		pthread_mutex_unlock(&parallel->mutex);
+	}
+}
+
+static int
+xml_istream_replay(xml_istream_t* self,
+                   xml_istreamLog_t* log,
+                   float progress,
+                   const char*** _atts, int* _atts_size)
+{
+	ASSERT(self);
+	ASSERT(log);
+	ASSERT(_atts);
+	ASSERT(_atts_size);
+
+	// chunks contain whole records so a skipped subtree
+	// ends in the same log
+	int depth = 0;
+	int skip  = 0;
+	int i;
+	for(i = 0; i < log->records_count; ++i)
+	{
+		xml_istreamRecord_t* record = &log->records[i];
+		const char* name = &log->arena[record->name];
+		int         line = record->line;
+
+		if(record->type == XML_ISTREAM_RECORD_START)
+		{
+			++depth;
+			if(skip)
+			{
+				continue;
+			}
+
+			// rebuild the atts array
+			if(record->natts + 1 > *_atts_size)
+			{
+				int size = 2*(record->natts + 1);
+
+				const char** atts;
+				atts = (const char**)
+				       REALLOC(*_atts, size*sizeof(const char*));
+				if(atts == NULL)
+				{
+					LOGE("REALLOC failed");
+					return 0;
+				}
+				*_atts      = atts;
+				*_atts_size = size;
+			}
+
+			const char** atts = *_atts;
+			int j;
+			for(j = 0; j < record->natts; ++j)
+			{
+				atts[j] = &log->arena[log->atts[record->atts + j]];
+			}
+			atts[record->natts] = NULL;
+
+			xml_istream_start_fn start_fn;
+			start_fn = xml_istream_startFn(self,
+			                               xml_istream_nameId(self, name,
+			                                                  self->intern_discover));
+			int ret = (*start_fn)(self->priv, line, progress,
+			                      name, atts);
+			if(ret == XML_ISTREAM_SKIP)
+			{
+				skip = depth;
+			}
+			else if(ret == XML_ISTREAM_STOP)
+			{
+				self->stopped = 1;
+				return 1;
+			}
+			else if(ret == XML_ISTREAM_ABORT)
+			{
+				return 0;
+			}
+		}
+		else if(skip)
+		{
+			// leave the skipped subtree without an end callback
+			if(skip == depth)
+			{
+				skip = 0;
+			}
+			--depth;
+		}
+		else
+		{
+			--depth;
+
+			const char* content = NULL;
+			if(record->len)
+			{
+				content = &log->arena[record->content];
+			}
+
+			xml_istream_end_fn end_fn;
+			end_fn = xml_istream_endFn(self,
+			                           xml_istream_nameId(self, name, 0));
+			int ret = (*end_fn)(self->priv, line, progress,
+			                    name, content, record->len);
+			if(ret == XML_ISTREAM_STOP)
+			{
+				self->stopped = 1;
+				return 1;
+			}
+			else if(ret == XML_ISTREAM_ABORT)
+			{
+				return 0;
+			}
+		}
+	}
+
+	xml_istream_logClear(log);
+	return 1;
+}
+
+static size_t
+xml_istream_findRecord(const char* buffer,
+                       size_t offset, size_t end,
+                       const char* record)
+{
+	ASSERT(buffer);
+	ASSERT(record);
+
+	size_t len = strlen(record);
+	while(offset < end)
+	{
+		const char* p;
+		p = (const char*) memchr(&buffer[offset], '<',
+		                         end - offset);
+		if(p == NULL)
+		{
+			break;
+		}
+
+		size_t i = (size_t) (p - buffer);
+		if(((i + len + 1) < end) &&
+		   (memcmp(&buffer[i + 1], record, len) == 0))
+		{
+			char c = buffer[i + len + 1];
+			if((c == ' ')  || (c == '\t') || (c == '\n') ||
+			   (c == '\r') || (c == '/')  || (c == '>'))
+			{
+				return i;
+			}
+		}
+		offset = i + 1;
+	}
+
+	return end;
+}
+
+static int xml_istream_parallelRun(xml_istreamParallel_t* parallel)
+{
+	ASSERT(parallel);
+
+	xml_istream_t* self = parallel->self;
+
+	parallel->logs = (xml_istreamLog_t*)
+	                 CALLOC(parallel->window,
+	                        sizeof(xml_istreamLog_t));
+	if(parallel->logs == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	parallel->done = (int*) CALLOC(parallel->window, sizeof(int));
+	if(parallel->done == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_done;
+	}
+
+	parallel->workers = (xml_istreamWorker_t*)
+	                    CALLOC(parallel->nworkers,
+	                           sizeof(xml_istreamWorker_t));
+	if(parallel->workers == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_workers;
+	}
+
+	int i;
+	for(i = 0; i < parallel->nworkers; ++i)
+	{
+		xml_istreamWorker_t* worker = &parallel->workers[i];
+		worker->parallel = parallel;
+		worker->istream  = xml_istream_new(worker,
+		                                   xml_istream_workerStart,
+		                                   xml_istream_workerEnd);
+		if(worker->istream == NULL)
+		{
+			goto fail_istream;
+		}
+
+		if(xml_istream_subscribeCopy(worker->istream,
+		                             self) == 0)
+		{
+			goto fail_istream;
+		}
+	}
+
+	if(pthread_mutex_init(&parallel->mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	if(pthread_cond_init(&parallel->cond, NULL) != 0)
+	{
+		LOGE("pthread_cond_init failed");
+		goto fail_cond;
+	}
+
+	// count the newlines in parallel and convert them to the
+	// line offsets of each chunk unless they are known
+	int    phase;
+	int    ret   = 1;
+	size_t first = parallel->bounds[0];
+	size_t tail  = parallel->bounds[parallel->nchunks];
+	for(phase = 0; phase < 2; ++phase)
+	{
+		parallel->phase = phase;
+		parallel->next  = 0;
+
+		int started = 0;
+		for(i = 0; i < parallel->nworkers; ++i)
+		{
+			if((phase == 0) && (parallel->count_lines == 0))
+			{
+				break;
+			}
+
+			xml_istreamWorker_t* worker = &parallel->workers[i];
+			if(pthread_create(&worker->thread, NULL,
+			                  xml_istream_workerThread,
+			                  (void*) worker) != 0)
+			{
+				LOGE("pthread_create failed");
+				break;
+			}
+			++started;
+		}
+
+		if((started == 0) &&
+		   ((phase == 1) || parallel->count_lines))
+		{
+			ret = 0;
+			break;
+		}
+
+		if(phase == 0)
+		{
+			for(i = 0; i < started; ++i)
+			{
+				pthread_join(parallel->workers[i].thread, NULL);
+			}
+
+			if(parallel->count_lines)
+			{
+				int lines = (int)
+				            xml_istream_countLines(parallel->buffer,
+				                                   first);
+				int k;
+				for(k = 0; k < parallel->nchunks; ++k)
+				{
+					int count = parallel->lines[k];
+					parallel->lines[k] = lines;
+					lines += count;
+				}
+				parallel->lines[parallel->nchunks] = lines;
+			}
+
+			// parse the prolog up to the first record or
+			// reopen the root element without the prolog
+			if(parallel->reopen)
+			{
+				int64_t prefix;
+				if(xml_istream_reopen(self, parallel->root, 1,
+				                      parallel->lines[0] + 1,
+				                      &prefix) == 0)
+				{
+					ret = 0;
+					break;
+				}
+			}
+			else if(xml_istream_parallelRange(parallel, self,
+			                                  &parallel->inflate,
+			                                  0, first, 0) == 0)
+			{
+				ret = 0;
+				break;
+			}
+
+			// the root element may stop the parse or skip
+			// the records which leaves the tail to close it
+			if(self->stopped || self->skip_depth)
+			{
+				break;
+			}
+			continue;
+		}
+
+		// replay the ordered logs on the calling thread
+		int k;
+		const char** atts      = NULL;
+		int          atts_size = 0;
+		for(k = 0; parallel->ordered && (k < parallel->nchunks); ++k)
+		{
+			int slot = k%parallel->window;
+
+			pthread_mutex_lock(&parallel->mutex);
+			while((parallel->done[slot] != (k + 1)) &&
+			      (parallel->error == 0))
+			{
+				pthread_cond_wait(&parallel->cond, &parallel->mutex);
+			}
+			int error = parallel->error;
+			pthread_mutex_unlock(&parallel->mutex);
+
+			if(error ||
+			   (xml_istream_replay(self, &parallel->logs[slot],
+			                       (float) ((double) parallel->bounds[k + 1] /
+			                                (double) parallel->total),
+			                       &atts, &atts_size) == 0))
+			{
+				ret = 0;
+			}
+
+			pthread_mutex_lock(&parallel->mutex);
+			if(ret == 0)
+			{
+				parallel->error = 1;
+			}
+			else if(self->stopped)
+			{
+				__atomic_store_n(&parallel->stop, 1,
+				                 __ATOMIC_RELAXED);
+			}
+			parallel->replayed = k + 1;
+			pthread_cond_broadcast(&parallel->cond);
+			pthread_mutex_unlock(&parallel->mutex);
+
+			if((ret == 0) || self->stopped)
+			{
+				break;
+			}
+		}
+		FREE(atts);
+
+		for(i = 0; i < started; ++i)
+		{
+			pthread_join(parallel->workers[i].thread, NULL);
+		}
+
+		if(parallel->error)
+		{
+			ret = 0;
+		}
+		else if(parallel->stop)
+		{
+			self->stopped = 1;
+		}
+	}
+
+	// parse the tail with the lines of the chunks unless a
+	// callback stopped the parse
+	if(ret && (self->stopped == 0))
+	{
+		self->line_offset += parallel->lines[parallel->nchunks] -
+		                     parallel->lines[0];
+		ret = xml_istream_parallelRange(parallel, self,
+		                                &parallel->inflate,
+		                                tail, parallel->total, 1);
+	}
+
+	pthread_cond_destroy(&parallel->cond);
+	pthread_mutex_destroy(&parallel->mutex);
+	for(i = 0; i < parallel->nworkers; ++i)
+	{
+		xml_inflate_delete(&parallel->workers[i].inflate);
+		xml_istream_delete(&parallel->workers[i].istream);
+	}
+	for(i = 0; i < parallel->window; ++i)
+	{
+		xml_istream_logFree(&parallel->logs[i]);
+	}
+	xml_inflate_delete(&parallel->inflate);
+	FREE(parallel->workers);
+	FREE(parallel->done);
+	FREE(parallel->logs);
+
+	// success
+	return ret;
+
+	// failure
+	fail_cond:
+		pthread_mutex_destroy(&parallel->mutex);
+	fail_mutex:
+	fail_istream:
+		for(i = 0; i < parallel->nworkers; ++i)
+		{
+			xml_istream_delete(&parallel->workers[i].istream);
+		}
+		FREE(parallel->workers);
+	fail_workers:
+		FREE(parallel->done);
+	fail_done:
+		FREE(parallel->logs);
+	return 0;
+}
+
+static int
+xml_istream_parseParallel(xml_istream_t* self,
+                          const char* buffer,
+                          size_t len, size_t slice)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	// find the first record and the closing root tag
+	// otherwise fall back to the serial parser
+	const char* record = self->parallel_record;
+	size_t first = xml_istream_findRecord(buffer, 0, len,
+	                                      record);
+	size_t tail = len;
+	while(tail > 1)
+	{
+		--tail;
+		if((buffer[tail - 1] == '<') && (buffer[tail] == '/'))
+		{
+			--tail;
+			break;
+		}
+	}
+	size_t root = tail + 2;
+	while((root < len) && (buffer[root] != '>') &&
+	      (buffer[root] != ' ') && (buffer[root] != '\t') &&
+	      (buffer[root] != '\r') && (buffer[root] != '\n'))
+	{
+		++root;
+	}
+	root -= tail + 2;
+	if((first >= tail) || (buffer[tail] != '<') ||
+	   (root == 0) || (root > 250))
+	{
+		return xml_istream_parseRange(self, buffer, 0, len, len,
+		                              slice, 1);
+	}
+
+	xml_istreamParallel_t parallel;
+	memset(&parallel, 0, sizeof(xml_istreamParallel_t));
+	snprintf(parallel.root, 256, "%.*s", (int) root,
+	         &buffer[tail + 2]);
+	snprintf(parallel.begin, 256, "<%s>", parallel.root);
+	snprintf(parallel.end, 256, "</%s>", parallel.root);
+	parallel.self        = self;
+	parallel.buffer      = buffer;
+	parallel.total       = len;
+	parallel.slice       = slice;
+	parallel.ordered     = self->parallel_ordered;
+	parallel.nworkers    = self->parallel_threads;
+	parallel.window      = parallel.ordered ?
+	                       2*parallel.nworkers : 1;
+	parallel.count_lines = 1;
+
+	// split the records into chunks
+	size_t nchunks = (tail - first)/XML_ISTREAM_PARALLEL_CHUNK + 1;
+	parallel.bounds = (size_t*)
+	                  CALLOC(nchunks + 1, sizeof(size_t));
+	if(parallel.bounds == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	parallel.bounds[0] = first;
+	while(parallel.bounds[parallel.nchunks] < tail)
+	{
+		size_t start = parallel.bounds[parallel.nchunks];
+		size_t split = start + XML_ISTREAM_PARALLEL_CHUNK;
+		size_t end   = tail;
+		if(split < tail)
+		{
+			end = xml_istream_findRecord(buffer, split, tail,
+			                             record);
+		}
+		parallel.bounds[++parallel.nchunks] = end;
+	}
+
+	parallel.lines = (int*)
+	                 CALLOC(parallel.nchunks + 1, sizeof(int));
+	if(parallel.lines == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_lines;
+	}
+
+	int ret = xml_istream_parallelRun(&parallel);
+
+	FREE(parallel.lines);
+	FREE(parallel.bounds);
+
+	// success
+	return ret;
+
+	// failure
+	fail_lines:
+		FREE(parallel.bounds);
+	return 0;
+}
+
+static int
+xml_istream_parseGzIndex(xml_istream_t* self,
+                         const char* gzname,
+                         const xml_gzindex_t* index,
+                         int first)
+{
+	ASSERT(self);
+	ASSERT(gzname);
+	ASSERT(index);
+
+	xml_istreamParallel_t parallel;
+	memset(&parallel, 0, sizeof(xml_istreamParallel_t));
+	snprintf(parallel.root, 256, "%s", index->root);
+	snprintf(parallel.begin, 256, "<%s>", parallel.root);
+	snprintf(parallel.end, 256, "</%s>", parallel.root);
+	parallel.self     = self;
+	parallel.gzname   = gzname;
+	parallel.index    = index;
+	parallel.total    = (size_t) index->len;
+	parallel.slice    = XML_ISTREAM_MMAP_SLICE;
+	parallel.ordered  = self->parallel_ordered;
+	parallel.nworkers = self->parallel_threads;
+	parallel.window   = parallel.ordered ?
+	                    2*parallel.nworkers : 1;
+	parallel.reopen   = (first > 0) ? 1 : 0;
+
+	// each index entry is a chunk where the lines are known
+	parallel.nchunks = index->entries_count - first;
+	parallel.bounds  = (size_t*)
+	                   CALLOC(parallel.nchunks + 1, sizeof(size_t));
+	if(parallel.bounds == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	parallel.lines = (int*)
+	                 CALLOC(parallel.nchunks + 1, sizeof(int));
+	if(parallel.lines == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_lines;
+	}
+
+	int k;
+	for(k = 0; k < parallel.nchunks; ++k)
+	{
+		const xml_gzindexEntry_t* entry;
+		entry = &index->entries[first + k];
+		parallel.bounds[k] = (size_t) entry->out;
+		parallel.lines[k]  = entry->line - 1;
+	}
+	parallel.bounds[parallel.nchunks] = (size_t) index->tail;
+	parallel.lines[parallel.nchunks]  = index->tail_line - 1;
+
+	int ret = xml_istream_parallelRun(&parallel);
+
+	FREE(parallel.lines);
+	FREE(parallel.bounds);
+
+	// success
+	return ret;
+
+	// failure
+	fail_lines:
+		FREE(parallel.bounds);
+	return 0;
+}
+
+static int
+xml_istream_gzLen(const char* gzname, size_t* _len)
+{
+	ASSERT(gzname);
+	ASSERT(_len);
+
+	// read the uncompressed file size which is stored in the
+	// last 4 bytes of the compressed file
+	// assumes that the uncompressed file is less than 4GB
+	// otherwise the file size may only be determined by
+	// decompressing the entire file
+	// the len is only used to provide a progress indicator
+	// for the istream parser
+	FILE* tmp = fopen(gzname, "r");
+	if(tmp == NULL)
+	{
+		LOGE("fopen %s failed", gzname);
+		return 0;
+	}
+
+	// seek the uncompressed file size
+	fseek(tmp, (long) 0, SEEK_END);
+	size_t len = ftell(tmp);
+	if(len < 4)
+	{
+		LOGE("invalid len=%i", (int) len);
+		fclose(tmp);
+		return 0;
+	}
+	fseek(tmp, len - 4, SEEK_SET);
+
+	// read the uncompressed file size bytes
+	unsigned char b1;
+	unsigned char b2;
+	unsigned char b3;
+	unsigned char b4;
+	if((fread(&b4, sizeof(char), 1, tmp) != 1) ||
+	   (fread(&b3, sizeof(char), 1, tmp) != 1) ||
+	   (fread(&b2, sizeof(char), 1, tmp) != 1) ||
+	   (fread(&b1, sizeof(char), 1, tmp) != 1))
+	{
+		LOGE("fread failed");
+		fclose(tmp);
+		return 0;
+	}
+	fclose(tmp);
+
+	// decode the uncompressed file size
+	unsigned int u1 = b1;
+	unsigned int u2 = b2;
+	unsigned int u3 = b3;
+	unsigned int u4 = b4;
+	*_len = (size_t) ((u1 << 24) | (u2 << 16) | (u3 << 8) | u4);
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+xml_istream_t*
+xml_istream_new(void* priv,
+                xml_istream_start_fn start_fn,
+                xml_istream_end_fn   end_fn)
+{
+	// priv, start_fn and end_fn may be NULL
+
+	xml_istream_t* self = (xml_istream_t*)
+	                      CALLOC(1, sizeof(xml_istream_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	XML_Parser parser = XML_ParserCreate("UTF-8");
+	if(parser == NULL)
+	{
+		LOGE("XML_ParserCreate failed");
+		goto fail_parser;
+	}
+
+	self->priv     = priv;
+	self->start_fn = start_fn;
+	self->end_fn   = end_fn;
+	self->parser   = parser;
+
+	// success
+	return self;
+
+	// failure
+	fail_parser:
+		FREE(self);
+	return NULL;
+}
+
+void xml_istream_delete(xml_istream_t** _self)
+{
+	ASSERT(_self);
+
+	xml_istream_t* self = *_self;
+	if(self)
+	{
+		XML_ParserFree(self->parser);
+		FREE(self->subs);
+		FREE(self->handlers);
+		FREE(self->ids);
+		FREE(self->checkpoint_stack);
+		FREE(self->checkpoint_names);
+		FREE(self->content_buf);
+		xml_istream_batchDelete(&self->batch);
+		xml_istream_treeDelete(&self->tree);
+		xml_istream_scanDelete(&self->scan);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int xml_istream_reset(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(xml_istream_parserReset(self) == 0)
+	{
+		return 0;
+	}
+
+	// reset the subscriptions
+	int i;
+	for(i = 0; i < self->subs_count; ++i)
+	{
+		self->subs[i].matched = 0;
+	}
+	self->subs_depth = 0;
+
+	// the content buffer is kept for reuse
+	self->error       = 0;
+	self->progress    = 0.0f;
+	self->content_len = 0;
+	self->depth       = 0;
+	self->line_offset = 0;
+	self->pull        = 0;
+	self->pull_buffer = NULL;
+	self->pull_file   = NULL;
+	self->pull_offset = 0;
+	self->pull_len    = 0;
+	self->pull_count  = 0;
+	self->pull_index  = 0;
+	self->concat      = 0;
+	self->doc_done    = 0;
+	self->doc_end     = 0;
+
+	self->progress_t0   = 0.0;
+	self->progress_last = 0.0;
+
+	self->skip_depth   = 0;
+	self->skip_pending = 0;
+	self->skip_end     = NULL;
+	self->stopped      = 0;
+
+	self->push           = 0;
+	self->push_suspended = 0;
+	self->push_offset    = 0;
+	self->push_len       = 0;
+
+	// the checkpoint stack is kept for reuse
+	self->checkpoint_last      = 0;
+	self->checkpoint_points    = 0;
+	self->checkpoint_restore   = 0;
+	self->checkpoint_base      = 0;
+	self->checkpoint_names_len = 0;
+
+	// the batch arena is kept for reuse
+	if(self->batch)
+	{
+		xml_istream_logClear(&self->batch->log);
+	}
+
+	// the tree arena is kept for reuse
+	if(self->tree)
+	{
+		xml_istream_treeClear(self->tree);
+	}
+
+	// the scanner buffers are kept for reuse
+	if(self->scan)
+	{
+		self->scan->active = 0;
+	}
+
+	return 1;
+}
+
+void xml_istream_stats(xml_istream_t* self,
+                       xml_stats_t* stats)
+{
+	ASSERT(self);
+
+	// stats may be NULL when disabled
+	self->stats = stats;
+}
+
+void xml_istream_progress(xml_istream_t* self,
+                          xml_istream_progress_fn progress_fn,
+                          double interval)
+{
+	ASSERT(self);
+
+	// progress_fn may be NULL when disabled
+	self->progress_fn       = progress_fn;
+	self->progress_interval = interval;
+	self->progress_t0       = 0.0;
+	self->progress_last     = 0.0;
+}
+
+int xml_istream_pipeline(xml_istream_t* self,
+                         int count, size_t size)
+{
+	ASSERT(self);
+
+	if((count < 0) ||
+	   ((count > 0) && ((size == 0) ||
+	                    (size > (size_t) 0x40000000))))
+	{
+		LOGE("invalid count=%i, size=%u",
+		     count, (unsigned int) size);
+		return 0;
+	}
+
+	self->pipeline_count = count;
+	self->pipeline_size  = size;
+
+	return 1;
+}
+
+int xml_istream_subscribe(xml_istream_t* self,
+                          const char* path)
+{
+	ASSERT(self);
+	ASSERT(path);
+
+	xml_istreamSubscription_t sub;
+	memset(&sub, 0, sizeof(xml_istreamSubscription_t));
+
+	// a leading slash is optional for paths
+	const char* p = path;
+	if(p[0] == '/')
+	{
+		++p;
+	}
+
+	if((p[0] == '\0') || (strlen(p) >= 256))
+	{
+		LOGE("invalid path=%s", path);
+		return 0;
+	}
+	snprintf(sub.path, 256, "%s", p);
+
+	// split the path into components
+	sub.absolute = (p != path) || (strchr(p, '/') != NULL);
+	sub.ncomp    = 1;
+
+	int i = 0;
+	while(sub.path[i] != '\0')
+	{
+		if(sub.path[i] == '/')
+		{
+			sub.path[i] = '\0';
+			if((sub.path[i + 1] == '\0') ||
+			   (sub.path[i + 1] == '/')   ||
+			   (sub.ncomp == XML_ISTREAM_SUBSCRIBE_MAX_DEPTH))
+			{
+				LOGE("invalid path=%s", path);
+				return 0;
+			}
+			sub.comp[sub.ncomp++] = i + 1;
+		}
+		++i;
+	}
+
+	xml_istreamSubscription_t* subs;
+	subs = (xml_istreamSubscription_t*)
+	       REALLOC(self->subs, (self->subs_count + 1)*
+	                           sizeof(xml_istreamSubscription_t));
+	if(subs == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	self->subs = subs;
+	self->subs[self->subs_count++] = sub;
+
+	return 1;
+}
+
+void xml_istream_unsubscribe(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	FREE(self->subs);
+	self->subs       = NULL;
+	self->subs_count = 0;
+	self->subs_depth = 0;
+}
+
+void xml_istream_intern(xml_istream_t* self,
+                        xml_intern_t* intern,
+                        int discover)
+{
+	ASSERT(self);
+
+	// intern may be NULL to disable dispatch
+	self->intern          = intern;
+	self->intern_discover = discover;
+}
+
+int xml_istream_handler(xml_istream_t* self, int id,
+                        xml_istream_start_fn start_fn,
+                        xml_istream_end_fn   end_fn)
+{
+	ASSERT(self);
+
+	// start_fn and end_fn may be NULL to use the defaults
+	if(id < 0)
+	{
+		LOGE("invalid id=%i", id);
+		return 0;
+	}
+
+	if(id >= self->handlers_count)
+	{
+		xml_istreamHandler_t* handlers;
+		handlers = (xml_istreamHandler_t*)
+		           REALLOC(self->handlers,
+		                   (id + 1)*sizeof(xml_istreamHandler_t));
+		if(handlers == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		int i;
+		for(i = self->handlers_count; i <= id; ++i)
+		{
+			handlers[i].start_fn = NULL;
+			handlers[i].end_fn   = NULL;
+		}
+		self->handlers       = handlers;
+		self->handlers_count = id + 1;
+	}
+
+	self->handlers[id].start_fn = start_fn;
+	self->handlers[id].end_fn   = end_fn;
+
+	return 1;
+}
+
+int xml_istream_attrIds(xml_istream_t* self,
+                        const char** atts,
+                        int* ids, int size)
+{
+	ASSERT(self);
+	ASSERT(atts);
+	ASSERT(ids);
+
+	int count = 0;
+	while(atts[2*count] && (count < size))
+	{
+		ids[count] = xml_istream_nameId(self, atts[2*count],
+		                                self->intern_discover);
+		++count;
+	}
+
+	return count;
+}
+
+int xml_istream_parallel(xml_istream_t* self,
+                         const char* record,
+                         int nthreads, int ordered)
+{
+	ASSERT(self);
+
+	// record may be NULL when disabled
+	if(nthreads <= 0)
+	{
+		self->parallel_threads = 0;
+		return 1;
+	}
+
+	if((record == NULL) || (record[0] == '\0') ||
+	   (strlen(record) >= 256))
+	{
+		LOGE("invalid record");
+		return 0;
+	}
+
+	snprintf(self->parallel_record, 256, "%s", record);
+	self->parallel_threads = nthreads;
+	self->parallel_ordered = ordered;
+
+	return 1;
+}
+
+int xml_istream_batch(xml_istream_t* self,
+                      xml_istream_batch_fn batch_fn,
+                      int count, int lines)
+{
+	ASSERT(self);
+
+	// batch_fn may be NULL when disabled
+	xml_istream_batchDelete(&self->batch);
+	if((batch_fn == NULL) || (count <= 0))
+	{
+		return 1;
+	}
+
+	xml_istreamBatch_t* batch;
+	batch = (xml_istreamBatch_t*)
+	        CALLOC(1, sizeof(xml_istreamBatch_t));
+	if(batch == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	batch->events = (xml_istreamEvent_t*)
+	                CALLOC(count, sizeof(xml_istreamEvent_t));
+	if(batch->events == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_events;
+	}
+
+	batch->batch_fn = batch_fn;
+	batch->count    = count;
+	batch->lines    = lines;
+	self->batch     = batch;
+
+	// success
+	return 1;
+
+	// failure
+	fail_events:
+		FREE(batch);
+	return 0;
+}
+
+int xml_istream_materialize(xml_istream_t* self,
+                            const char* name,
+                            xml_istream_tree_fn tree_fn)
+{
+	ASSERT(self);
+
+	// name and tree_fn may be NULL when disabled
+	if((name == NULL) || (tree_fn == NULL))
+	{
+		xml_istream_treeDelete(&self->tree);
+		return 1;
+	}
+
+	if((name[0] == '\0') || (strlen(name) >= 256))
+	{
+		LOGE("invalid name");
+		return 0;
+	}
+
+	if(self->tree == NULL)
+	{
+		self->tree = (xml_istreamTree_t*)
+		             CALLOC(1, sizeof(xml_istreamTree_t));
+		if(self->tree == NULL)
+		{
+			LOGE("CALLOC failed");
+			return 0;
+		}
+	}
+
+	xml_istreamTree_t* tree = self->tree;
+
+	xml_istreamTreeName_t* names;
+	names = (xml_istreamTreeName_t*)
+	        REALLOC(tree->names,
+	                (tree->names_count + 1)*
+	                sizeof(xml_istreamTreeName_t));
+	if(names == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	tree->names = names;
+
+	xml_istreamTreeName_t* tn = &names[tree->names_count];
+	snprintf(tn->name, 256, "%s", name);
+	tn->tree_fn = tree_fn;
+	++tree->names_count;
+
+	return 1;
+}
+
+void xml_istream_fastSkip(xml_istream_t* self, int enable)
+{
+	ASSERT(self);
+
+	self->skip_fast = enable;
+}
+
+int xml_istream_scanner(xml_istream_t* self, int enable)
+{
+	ASSERT(self);
+
+	if(enable == 0)
+	{
+		xml_istream_scanDelete(&self->scan);
+		return 1;
+	}
+	else if(self->scan)
+	{
+		return 1;
+	}
+
+	self->scan = (xml_istreamScan_t*)
+	             CALLOC(1, sizeof(xml_istreamScan_t));
+	if(self->scan == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	return 1;
+}
+
+int xml_istream_checkpoint(xml_istream_t* self,
+                           const char* fname,
+                           size_t interval)
+{
+	ASSERT(self);
+
+	// fname may be NULL when disabled
+	if(interval == 0)
+	{
+		self->checkpoint_interval = 0;
+		return 1;
+	}
+
+	// reserve space for the temporary file suffix
+	if((fname == NULL) || (fname[0] == '\0') ||
+	   (strlen(fname) >= 252))
+	{
+		LOGE("invalid fname");
+		return 0;
+	}
+
+	snprintf(self->checkpoint_fname, 256, "%s", fname);
+	self->checkpoint_interval = interval;
+
+	return 1;
+}
+
+int xml_istream_read(xml_istream_t* self,
+                     const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	// memory map regular files and parse the mapped pages
+	// directly otherwise fall back to the read path
+	int fd = open(fname, O_RDONLY);
+	if(fd == -1)
+	{
+		LOGE("open %s failed", fname);
+		return 0;
+	}
+
+	// decode compressed files detected by the magic bytes
+	unsigned char magic[4];
+	ssize_t       count  = pread(fd, magic, 4, 0);
+	int           format = xml_istream_format(magic,
+	                                          (count > 0) ?
+	                                          (size_t) count : 0);
+	if(format != XML_ISTREAM_FORMAT_XML)
+	{
+		close(fd);
+		if(format == XML_ISTREAM_FORMAT_GZ)
+		{
+			return xml_istream_readGz(self, fname);
+		}
+		else if(format == XML_ISTREAM_FORMAT_ZSTD)
+		{
+			return xml_istream_readZstd(self, fname);
+		}
+		return xml_istream_readLz4(self, fname);
+	}
+
+	struct stat st;
+	if((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) &&
+	   (st.st_size > 0))
+	{
+		size_t size = (size_t) st.st_size;
+		void*  addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+		                   fd, 0);
+		if(addr != MAP_FAILED)
+		{
+			// hints are advisory so errors are ignored
+			madvise(addr, size, MADV_SEQUENTIAL);
+			#ifdef MADV_HUGEPAGE
+				madvise(addr, size, MADV_HUGEPAGE);
+			#endif
+
+			int ret;
+			ret = xml_istream_readBufferSlice(self,
+			                                  (const char*) addr,
+			                                  size,
+			                                  XML_ISTREAM_MMAP_SLICE);
+			munmap(addr, size);
+			close(fd);
+			return ret;
+		}
+	}
+	close(fd);
+
+	FILE* f = fopen(fname, "r");
+	if(f == NULL)
+	{
+		LOGE("fopen %s failed", fname);
+		return 0;
+	}
+
+	// get file len
+	if(fseek(f, (long) 0, SEEK_END) == -1)
+	{
+		LOGE("fseek_end fname=%s", fname);
+		goto fail_fseek_end;
+	}
+	size_t len = ftell(f);
+
+	// rewind to start
+	if(fseek(f, 0, SEEK_SET) == -1)
+	{
+		LOGE("fseek_set fname=%s", fname);
+		goto fail_fseek_set;
+	}
+
+	int ret = xml_istream_readFile(self, f, len);
+	fclose(f);
+
+	// success
+	return ret;
+
+	// failure
+	fail_fseek_set:
+	fail_fseek_end:
+		fclose(f);
+	return 0;
+}
+
+int xml_istream_readGz(xml_istream_t* self,
+                       const char* gzname)
+{
+	ASSERT(self);
+	ASSERT(gzname);
+
+	size_t len;
+	if(xml_istream_gzLen(gzname, &len) == 0)
+	{
+		return 0;
+	}
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	// checkpoints require the access points of the inflate
+	// reader rather than gzread
+	if(self->checkpoint_interval)
+	{
+		return xml_istream_parseCheckpointGz(self, gzname, NULL,
+		                                     NULL, NULL, len);
+	}
+
+	gzFile f = gzopen(gzname, "rb");
+	if(f == NULL)
+	{
+		LOGE("gzopen %s failed", gzname);
+		return 0;
+	}
+
+	if(self->pipeline_count)
+	{
+		if(xml_istream_parseGzPipeline(self, f, len) == 0)
+		{
+			goto fail_parse;
+		}
+	}
+	else if(xml_istream_parseGzFile(self, f, len) == 0)
+	{
+		goto fail_parse;
+	}
+
+	gzclose(f);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		gzclose(f);
+	return 0;
+}
+
+int xml_istream_readZstd(xml_istream_t* self,
+                         const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	#ifdef XML_ISTREAM_ZSTD
+		if(xml_istream_reset(self) == 0)
+		{
+			return 0;
+		}
+
+		size_t len;
+		FILE*  f = xml_istream_fopen(fname, &len);
+		if(f == NULL)
+		{
+			return 0;
+		}
+
+		int ret = xml_istream_parseZstdFile(self, f, len);
+		fclose(f);
+
+		return ret;
+	#else
+		LOGE("zstd unsupported fname=%s", fname);
+		return 0;
+	#endif
+}
+
+int xml_istream_readLz4(xml_istream_t* self,
+                        const char* fname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+
+	#ifdef XML_ISTREAM_LZ4
+		if(xml_istream_reset(self) == 0)
+		{
+			return 0;
+		}
+
+		size_t len;
+		FILE*  f = xml_istream_fopen(fname, &len);
+		if(f == NULL)
+		{
+			return 0;
+		}
+
+		int ret = xml_istream_parseLz4File(self, f, len);
+		fclose(f);
+
+		return ret;
+	#else
+		LOGE("lz4 unsupported fname=%s", fname);
+		return 0;
+	#endif
+}
+
+int xml_istream_readFile(xml_istream_t* self,
+                         FILE* f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	// parse file
+	int    done  = 0;
+	size_t part  = 0;
+	size_t total = len;
+	while(done == 0)
+	{
+		void* buf = XML_GetBuffer(self->parser, 4096);
+		if(buf == NULL)
+		{
+			LOGE("XML_GetBuffer buf=NULL");
+			return 0;
+		}
+
+		double t0    = xml_istream_statsTime(self);
+		int    bytes = fread(buf, 1, len > 4096 ? 4096 : len, f);
+		xml_istream_statsIo(self, t0);
+		if(bytes < 0)
+		{
+			LOGE("read failed");
+			return 0;
+		}
+
+		len  -= bytes;
+		done  = (len == 0) ? 1 : 0;
+		part += bytes;
+		self->progress = (float) ((double) part / (double) total);
+		if(xml_istream_expatParseBuffer(self, bytes, done) == 0)
+		{
+			// callbacks may stop the parser early
+			if(self->stopped)
+			{
+				return self->error ? 0 : 1;
+			}
+
+			// make sure str is null terminated
+			char* str = (char*) buf;
+			str[(bytes > 0) ? (bytes - 1) : 0] = '\0';
+
+			enum XML_Error e = XML_GetErrorCode(self->parser);
+			int line = XML_GetCurrentLineNumber(self->parser);
+			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i, buf=%s",
+			     XML_ErrorString(e), line, bytes, str);
+			return 0;
+		}
+		else if(self->error)
+		{
+			return 0;
+		}
+	}
+
+	// succcess
+	return 1;
+}
+
+int xml_istream_readBuffer(xml_istream_t* self,
+                           const char* buffer,
+                           size_t len)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	return xml_istream_readBufferSlice(self, buffer, len,
+	                                   4096);
+}
+
+int xml_istream_readBufferSlice(xml_istream_t* self,
+                                const char* buffer,
+                                size_t len, size_t slice)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	// limit slices to the XML_Parse int len
+	if((slice == 0) || (slice > (size_t) 0x40000000))
+	{
+		LOGE("invalid slice=%u", (unsigned int) slice);
+		return 0;
+	}
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	if((self->parallel_threads > 0) &&
+	   (self->batch == NULL) && (self->tree == NULL))
+	{
+		return xml_istream_parseParallel(self, buffer, len, slice);
+	}
+
+	return xml_istream_parseRange(self, buffer, 0, len, len,
+	                              slice, 1);
+}
+
+int xml_istream_restore(xml_istream_t* self,
+                        const char* fname,
+                        const char* ckname)
+{
+	ASSERT(self);
+	ASSERT(fname);
+	ASSERT(ckname);
+
+	xml_istreamCheckpoint_t ck;
+	char* names  = NULL;
+	int   exists = 0;
+	if(xml_istream_checkpointLoad(ckname, &ck, &names, NULL,
+	                              &exists) == 0)
+	{
+		return 0;
+	}
+	else if(exists == 0)
+	{
+		return xml_istream_read(self, fname);
+	}
+
+	int fd = open(fname, O_RDONLY);
+	if(fd == -1)
+	{
+		LOGE("open %s failed", fname);
+		goto fail_open;
+	}
+
+	struct stat st;
+	if((fstat(fd, &st) != 0) || (S_ISREG(st.st_mode) == 0) ||
+	   (st.st_size < ck.offset))
+	{
+		LOGE("invalid %s", fname);
+		goto fail_stat;
+	}
+
+	size_t size = (size_t) st.st_size;
+	void*  addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+	                   fd, 0);
+	if(addr == MAP_FAILED)
+	{
+		LOGE("mmap %s failed", fname);
+		goto fail_mmap;
+	}
+	madvise(addr, size, MADV_SEQUENTIAL);
+
+	if((xml_istream_reset(self) == 0) ||
+	   (xml_istream_checkpointRestore(self, &ck, names) == 0) ||
+	   (xml_istream_parseRange(self, (const char*) addr,
+	                           (size_t) ck.offset, size, size,
+	                           XML_ISTREAM_MMAP_SLICE, 1) == 0))
+	{
+		goto fail_parse;
+	}
+
+	munmap(addr, size);
+	close(fd);
+	FREE(names);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		munmap(addr, size);
+	fail_mmap:
+	fail_stat:
+		close(fd);
+	fail_open:
+		FREE(names);
+	return 0;
+}
+
+int xml_istream_restoreGz(xml_istream_t* self,
+                          const char* gzname,
+                          const char* ckname)
+{
+	ASSERT(self);
+	ASSERT(gzname);
+	ASSERT(ckname);
+
+	xml_inflatePoint_t* point;
+	point = (xml_inflatePoint_t*)
+	        MALLOC(sizeof(xml_inflatePoint_t));
+	if(point == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+
+	xml_istreamCheckpoint_t ck;
+	char* names  = NULL;
+	int   exists = 0;
+	if(xml_istream_checkpointLoad(ckname, &ck, &names, point,
+	                              &exists) == 0)
+	{
+		goto fail_load;
+	}
+	else if(exists == 0)
+	{
+		FREE(point);
+		return xml_istream_readGz(self, gzname);
+	}
+
+	size_t len;
+	if((xml_istream_gzLen(gzname, &len) == 0) ||
+	   (xml_istream_reset(self) == 0)         ||
+	   (xml_istream_parseCheckpointGz(self, gzname, &ck, names,
+	                                  point, len) == 0))
+	{
+		goto fail_parse;
+	}
+
+	FREE(names);
+	FREE(point);
+
+	// success
+	return 1;
+
+	// failure
+	fail_parse:
+		FREE(names);
+	fail_load:
+		FREE(point);
+	return 0;
+}
+
+int xml_istream_readGzIndex(xml_istream_t* self,
+                            const char* gzname,
+                            const xml_gzindex_t* index,
+                            int first)
+{
+	ASSERT(self);
+	ASSERT(gzname);
+	ASSERT(index);
+
+	if((first < 0) || (first >= index->entries_count))
+	{
+		LOGE("invalid first=%i", first);
+		return 0;
+	}
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	if((self->parallel_threads > 0) &&
+	   (self->batch == NULL) && (self->tree == NULL))
+	{
+		return xml_istream_parseGzIndex(self, gzname, index,
+		                                first);
+	}
+
+	// reopen the root element to start at the entry
+	size_t offset = 0;
+	if(first > 0)
+	{
+		const xml_gzindexEntry_t* entry = &index->entries[first];
+
+		int64_t prefix;
+		if(xml_istream_reopen(self, index->root, 1, entry->line,
+		                      &prefix) == 0)
+		{
+			return 0;
+		}
+		offset = (size_t) entry->out;
+	}
+
+	xml_inflate_t* inflate = NULL;
+	int ret = xml_istream_parseGzRange(self, &inflate, gzname,
+	                                   index, offset,
+	                                   (size_t) index->len,
+	                                   (size_t) index->len, 1);
+	xml_inflate_delete(&inflate);
+
+	return ret;
+}
+
+int xml_istream_readConcat(xml_istream_t* self,
+                           const char* buffer,
+                           size_t len)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	size_t offset = 0;
+	while(1)
+	{
+		// skip whitespace between documents
+		while(offset < len)
+		{
+			char c = buffer[offset];
+			if((c == '\t') ||
+			   (c == '\n') ||
+			   (c == '\r') ||
+			   (c == ' '))
+			{
+				++offset;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if(offset == len)
+		{
+			break;
+		}
+
+		// parse the next document up to the end of its root
+		// element which is reported by xml_istream_end
+		if(xml_istream_reset(self) == 0)
+		{
+			return 0;
+		}
+		self->concat = 1;
+
+		if(xml_istream_parseRange(self, buffer, offset, len, len,
+		                          XML_ISTREAM_MMAP_SLICE, 1) == 0)
+		{
+			return 0;
+		}
+
+		if(self->doc_done == 0)
+		{
+			break;
+		}
+		offset += self->doc_end;
+	}
+
+	return 1;
+}
+
+int xml_istream_pullBuffer(xml_istream_t* self,
+                           const char* buffer,
+                           size_t len)
+{
+	ASSERT(self);
+	ASSERT(buffer);
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	self->pull        = 1;
+	self->pull_buffer = buffer;
+	self->pull_len    = len;
+
+	return 1;
+}
+
+int xml_istream_pullFile(xml_istream_t* self,
+                         FILE* f, size_t len)
+{
+	ASSERT(self);
+	ASSERT(f);
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	self->pull      = 1;
+	self->pull_file = f;
+	self->pull_len  = len;
+
+	return 1;
+}
+
+int xml_istream_next(xml_istream_t* self,
+                     xml_istreamEvent_t* event)
+{
+	ASSERT(self);
+	ASSERT(event);
+
+	// deliver the second event of an empty element
+	if(self->pull_index < self->pull_count)
+	{
+		*event = self->pull_events[self->pull_index++];
+		return 1;
+	}
+	self->pull_count = 0;
+	self->pull_index = 0;
+
+	// resume the suspended parser or parse the next slice
+	// of input until an event is produced
+	while(self->pull && (self->error == 0))
+	{
+		XML_ParsingStatus ps;
+		XML_GetParsingStatus(self->parser, &ps);
+		if(ps.parsing == XML_FINISHED)
+		{
+			break;
+		}
+
+		enum XML_Status status;
+		if(ps.parsing == XML_SUSPENDED)
+		{
+			status = xml_istream_expatResume(self);
+		}
+		else
+		{
+			status = xml_istream_pullParse(self);
+		}
+
+		if(status == XML_STATUS_ERROR)
+		{
+			if(self->error == 0)
+			{
+				enum XML_Error e = XML_GetErrorCode(self->parser);
+				int line = XML_GetCurrentLineNumber(self->parser) +
+				           self->line_offset;
+				LOGE("XML_Parse err=%s, line=%i",
+				     XML_ErrorString(e), line);
+				self->error = 1;
+			}
+			break;
+		}
+		else if(self->error)
+		{
+			break;
+		}
+		else if(self->pull_count)
+		{
+			*event = self->pull_events[self->pull_index++];
+			return 1;
+		}
+	}
+
+	// end of document or error
+	self->pull = 0;
+	return 0;
+}
+
+int xml_istream_push(xml_istream_t* self, size_t len)
+{
+	ASSERT(self);
+
+	if(xml_istream_reset(self) == 0)
+	{
+		return 0;
+	}
+
+	self->push     = 1;
+	self->push_len = len;
+
+	return 1;
+}
+
+int xml_istream_feed(xml_istream_t* self,
+                     const char* buf, size_t len)
+{
+	ASSERT(self);
+	ASSERT(buf || (len == 0));
+
+	if(xml_istream_pushReady(self) == 0)
+	{
+		return XML_ISTREAM_FEED_ERROR;
+	}
+	else if(self->stopped)
+	{
+		return XML_ISTREAM_FEED_OK;
+	}
+
+	// limit chunks to the XML_Parse int len
+	if(len > (size_t) 0x40000000)
+	{
+		LOGE("invalid len=%u", (unsigned int) len);
+		self->error = 1;
+		return XML_ISTREAM_FEED_ERROR;
+	}
+
+	if(len == 0)
+	{
+		return XML_ISTREAM_FEED_OK;
+	}
+
+	self->push_offset += len;
+	if(self->push_len)
+	{
+		self->progress = (float) ((double) self->push_offset /
+		                          (double) self->push_len);
+	}
+
+	return xml_istream_pushStatus(self,
+	                              xml_istream_expatParse(self, buf,
+	                                                     (int) len, 0));
+}
 
-		done  = (bytes == 0) ? 1 : 0;
-		part += bytes;
-		self->progress = (float) ((double) part / (double) total);
-		if(XML_ParseBuffer(self->parser, bytes, done) == 0)
-		{
-			// make sure str is null terminated
-			char* str = (char*) buf;
-			str[(bytes > 0) ? (bytes - 1) : 0] = '\0';
+int xml_istream_feedv(xml_istream_t* self,
+                      const struct iovec* iov,
+                      int iovcnt, int* _count)
+{
+	ASSERT(self);
+	ASSERT(iov || (iovcnt == 0));
+	ASSERT(_count);
 
-			enum XML_Error e = XML_GetErrorCode(self->parser);
-			int line = XML_GetCurrentLineNumber(self->parser);
-			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i, buf=%s",
-			     XML_ErrorString(e), line, bytes, str);
-			goto fail_parse;
-		}
-		else if(self->error)
+	// each entry is fed separately rather than coalesced
+	int status = XML_ISTREAM_FEED_OK;
+	int i;
+	for(i = 0; i < iovcnt; ++i)
+	{
+		status = xml_istream_feed(self,
+		                          (const char*) iov[i].iov_base,
+		                          iov[i].iov_len);
+		if(status != XML_ISTREAM_FEED_OK)
 		{
-			goto fail_parse;
+			break;
 		}
 	}
 
-	xml_istream_delete(&self);
+	// the suspended entry was accepted by the parser
+	*_count = (status == XML_ISTREAM_FEED_ERROR) ? i :
+	          ((i < iovcnt) ? (i + 1) : i);
+	return status;
+}
 
-	// succcess
-	return 1;
+void xml_istream_suspend(xml_istream_t* self)
+{
+	ASSERT(self);
 
-	// failure
-	fail_parse:
-		xml_istream_delete(&self);
-	return 0;
+	// suspension is only supported for push parsing
+	if(self->push)
+	{
+		XML_StopParser(self->parser, XML_TRUE);
+	}
 }
 
-/***********************************************************
-* public                                                   *
-***********************************************************/
+int xml_istream_resume(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if((self->push == 0) || (self->push_suspended == 0))
+	{
+		LOGE("invalid resume");
+		return XML_ISTREAM_FEED_ERROR;
+	}
+	self->push_suspended = 0;
+
+	return xml_istream_pushStatus(self,
+	                              xml_istream_expatResume(self));
+}
+
+int xml_istream_finish(xml_istream_t* self)
+{
+	ASSERT(self);
+
+	if(xml_istream_pushReady(self) == 0)
+	{
+		self->push = 0;
+		return 0;
+	}
+
+	// suspension is ignored while finishing the document
+	int status;
+	status = xml_istream_pushStatus(self,
+	                                xml_istream_expatParse(self,
+	                                                       NULL, 0, 1));
+	while(status == XML_ISTREAM_FEED_SUSPENDED)
+	{
+		self->push_suspended = 0;
+		status = xml_istream_pushStatus(self,
+		                                xml_istream_expatResume(self));
+	}
+
+	self->push     = 0;
+	self->progress = 1.0f;
+	return (status == XML_ISTREAM_FEED_OK) ? 1 : 0;
+}
 
 int xml_istream_parse(void* priv,
                       xml_istream_start_fn start_fn,
@@ -297,40 +6461,17 @@ int xml_istream_parse(void* priv,
 	ASSERT(end_fn);
 	ASSERT(fname);
 
-	FILE* f = fopen(fname, "r");
-	if(f == NULL)
+	xml_istream_t* self;
+	self = xml_istream_new(priv, start_fn, end_fn);
+	if(self == NULL)
 	{
-		LOGE("fopen %s failed", fname);
 		return 0;
 	}
 
-	// get file len
-	if(fseek(f, (long) 0, SEEK_END) == -1)
-	{
-		LOGE("fseek_end fname=%s", fname);
-		goto fail_fseek_end;
-	}
-	size_t len = ftell(f);
-
-	// rewind to start
-	if(fseek(f, 0, SEEK_SET) == -1)
-	{
-		LOGE("fseek_set fname=%s", fname);
-		goto fail_fseek_set;
-	}
-
-	int ret = xml_istream_parseFile(priv, start_fn,
-	                                end_fn, f, len);
-	fclose(f);
+	int ret = xml_istream_read(self, fname);
+	xml_istream_delete(&self);
 
-	// success
 	return ret;
-
-	// failure
-	fail_fseek_set:
-	fail_fseek_end:
-		fclose(f);
-	return 0;
 }
 
 int xml_istream_parseGz(void* priv,
@@ -343,76 +6484,63 @@ int xml_istream_parseGz(void* priv,
 	ASSERT(end_fn);
 	ASSERT(gzname);
 
-	// read the uncompressed file size which is stored in the
-	// last 4 bytes of the compressed file
-	// assumes that the uncompressed file is less than 4GB
-	// otherwise the file size may only be determined by
-	// decompressing the entire file
-	// the len is only used to provide a progress indicator
-	// for the istream parser
-	FILE* tmp = fopen(gzname, "r");
-	if(tmp == NULL)
+	xml_istream_t* self;
+	self = xml_istream_new(priv, start_fn, end_fn);
+	if(self == NULL)
 	{
-		LOGE("fopen %s failed", gzname);
 		return 0;
 	}
 
-	// seek the uncompressed file size
-	fseek(tmp, (long) 0, SEEK_END);
-	size_t len = ftell(tmp);
-	if(len < 4)
-	{
-		LOGE("invalid len=%i", (int) len);
-		fclose(tmp);
-		return 0;
-	}
-	fseek(tmp, len - 4, SEEK_SET);
+	int ret = xml_istream_readGz(self, gzname);
+	xml_istream_delete(&self);
 
-	// read the uncompressed file size bytes
-	unsigned char b1;
-	unsigned char b2;
-	unsigned char b3;
-	unsigned char b4;
-	if((fread(&b4, sizeof(char), 1, tmp) != 1) ||
-	   (fread(&b3, sizeof(char), 1, tmp) != 1) ||
-	   (fread(&b2, sizeof(char), 1, tmp) != 1) ||
-	   (fread(&b1, sizeof(char), 1, tmp) != 1))
-	{
-		LOGE("fread failed");
-		fclose(tmp);
-		return 0;
-	}
-	fclose(tmp);
+	return ret;
+}
 
-	// decode the uncompressed file size
-	unsigned int u1 = b1;
-	unsigned int u2 = b2;
-	unsigned int u3 = b3;
-	unsigned int u4 = b4;
-	len = (size_t) ((u1 << 24) | (u2 << 16) | (u3 << 8) | u4);
+int xml_istream_parseZstd(void* priv,
+                          xml_istream_start_fn start_fn,
+                          xml_istream_end_fn   end_fn,
+                          const char* fname)
+{
+	// priv may be NULL
+	ASSERT(start_fn);
+	ASSERT(end_fn);
+	ASSERT(fname);
 
-	gzFile f = gzopen(gzname, "rb");
-	if(f == NULL)
+	xml_istream_t* self;
+	self = xml_istream_new(priv, start_fn, end_fn);
+	if(self == NULL)
 	{
-		LOGE("gzopen %s failed", gzname);
 		return 0;
 	}
 
-	if(xml_istream_parseGzFile(priv, start_fn, end_fn, f,
-	                           len) == 0)
+	int ret = xml_istream_readZstd(self, fname);
+	xml_istream_delete(&self);
+
+	return ret;
+}
+
+int xml_istream_parseLz4(void* priv,
+                         xml_istream_start_fn start_fn,
+                         xml_istream_end_fn   end_fn,
+                         const char* fname)
+{
+	// priv may be NULL
+	ASSERT(start_fn);
+	ASSERT(end_fn);
+	ASSERT(fname);
+
+	xml_istream_t* self;
+	self = xml_istream_new(priv, start_fn, end_fn);
+	if(self == NULL)
 	{
-		goto fail_parse;
+		return 0;
 	}
 
-	gzclose(f);
-
-	// success
-	return 1;
+	int ret = xml_istream_readLz4(self, fname);
+	xml_istream_delete(&self);
 
-	// failure
-	fail_parse:
-		gzclose(f);
-	return 0;
+	return ret;
 }
 
 int xml_istream_parseFile(void* priv,
@@ -432,57 +6560,10 @@ int xml_istream_parseFile(void* priv,
 		return 0;
 	}
 
-	// parse file
-	int    done  = 0;
-	size_t part  = 0;
-	size_t total = len;
-	while(done == 0)
-	{
-		void* buf = XML_GetBuffer(self->parser, 4096);
-		if(buf == NULL)
-		{
-			LOGE("XML_GetBuffer buf=NULL");
-			goto fail_parse;
-		}
-
-		int bytes = fread(buf, 1, len > 4096 ? 4096 : len, f);
-		if(bytes < 0)
-		{
-			LOGE("read failed");
-			goto fail_parse;
-		}
-
-		len  -= bytes;
-		done  = (len == 0) ? 1 : 0;
-		part += bytes;
-		self->progress = (float) ((double) part / (double) total);
-		if(XML_ParseBuffer(self->parser, bytes, done) == 0)
-		{
-			// make sure str is null terminated
-			char* str = (char*) buf;
-			str[(bytes > 0) ? (bytes - 1) : 0] = '\0';
-
-			enum XML_Error e = XML_GetErrorCode(self->parser);
-			int line = XML_GetCurrentLineNumber(self->parser);
-			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i, buf=%s",
-			     XML_ErrorString(e), line, bytes, str);
-			goto fail_parse;
-		}
-		else if(self->error)
-		{
-			goto fail_parse;
-		}
-	}
-
+	int ret = xml_istream_readFile(self, f, len);
 	xml_istream_delete(&self);
 
-	// succcess
-	return 1;
-
-	// failure
-	fail_parse:
-		xml_istream_delete(&self);
-	return 0;
+	return ret;
 }
 
 int xml_istream_parseBuffer(void* priv,
@@ -496,6 +6577,21 @@ int xml_istream_parseBuffer(void* priv,
 	ASSERT(end_fn);
 	ASSERT(buffer);
 
+	return xml_istream_parseBufferSlice(priv, start_fn, end_fn,
+	                                    buffer, len, 4096);
+}
+
+int xml_istream_parseBufferSlice(void* priv,
+                                 xml_istream_start_fn start_fn,
+                                 xml_istream_end_fn   end_fn,
+                                 const char* buffer,
+                                 size_t len, size_t slice)
+{
+	// priv may be NULL
+	ASSERT(start_fn);
+	ASSERT(end_fn);
+	ASSERT(buffer);
+
 	xml_istream_t* self;
 	self = xml_istream_new(priv, start_fn, end_fn);
 	if(self == NULL)
@@ -503,54 +6599,9 @@ int xml_istream_parseBuffer(void* priv,
 		return 0;
 	}
 
-	// parse buffer
-	int    done   = 0;
-	int    offset = 0;
-	size_t part   = 0;
-	size_t total  = len;
-	while(done == 0)
-	{
-		void* buf = XML_GetBuffer(self->parser, 4096);
-		if(buf == NULL)
-		{
-			LOGE("XML_GetBuffer buf=NULL");
-			goto fail_parse;
-		}
-
-		size_t left  = len - offset;
-		int    bytes = (left > 4096) ? 4096 : left;
-		memcpy(buf, &buffer[offset], bytes);
-
-		done  = (bytes == 0) ? 1 : 0;
-		part += bytes;
-		self->progress = (float) ((double) part / (double) total);
-		if(XML_ParseBuffer(self->parser, bytes, done) == 0)
-		{
-			// make sure str is null terminated
-			char* str = (char*) buf;
-			str[(bytes > 0) ? (bytes - 1) : 0] = '\0';
-
-			enum XML_Error e = XML_GetErrorCode(self->parser);
-			int line = XML_GetCurrentLineNumber(self->parser);
-			LOGE("XML_ParseBuffer err=%s, line=%i, bytes=%i, buf=%s",
-			     XML_ErrorString(e), line, bytes, str);
-			goto fail_parse;
-		}
-		else if(self->error)
-		{
-			goto fail_parse;
-		}
-
-		offset += bytes;
-	}
-
+	int ret = xml_istream_readBufferSlice(self, buffer, len,
+	                                      slice);
 	xml_istream_delete(&self);
 
-	// success
-	return 1;
-
-	// failure
-	fail_parse:
-		xml_istream_delete(&self);
-	return 0;
+	return ret;
 }
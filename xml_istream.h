@@ -25,7 +25,21 @@
 #define xml_istream_H
 
 #include <stdio.h>
+#include <sys/uio.h>
 #include "../libexpat/expat/lib/expat.h"
+#include "xml_gzindex.h"
+#include "xml_inflate.h"
+#include "xml_intern.h"
+#include "xml_stats.h"
+
+// callback return codes where skip is only valid for start
+// callbacks and skips the subtree of the element without
+// further callbacks (including the end callback of the
+// element) and stop ends the parse successfully
+#define XML_ISTREAM_ABORT    0
+#define XML_ISTREAM_CONTINUE 1
+#define XML_ISTREAM_SKIP     2
+#define XML_ISTREAM_STOP     3
 
 typedef int (*xml_istream_start_fn)(void* priv,
                                     int line,
@@ -36,8 +50,423 @@ typedef int (*xml_istream_end_fn)(void* priv,
                                   int line,
                                   float progress,
                                   const char* name,
-                                  const char* content);
+                                  const char* content,
+                                  size_t len);
+
+// elapsed and eta are in seconds where eta is negative
+// until progress is known and stats may be NULL
+typedef int (*xml_istream_progress_fn)(void* priv,
+                                       float progress,
+                                       double elapsed,
+                                       double eta,
+                                       const xml_stats_t* stats);
+
+typedef struct
+{
+	xml_istream_start_fn start_fn;
+	xml_istream_end_fn   end_fn;
+} xml_istreamHandler_t;
+
+// pull parsing event types
+#define XML_ISTREAM_EVENT_START 1
+#define XML_ISTREAM_EVENT_END   2
+
+// names, atts and content reference parser memory which
+// remains valid until the next call to xml_istream_next
+// id is the interned name id or -1 without an intern table
+typedef struct
+{
+	int          type;
+	int          id;
+	int          depth;
+	int          line;
+	float        progress;
+	const char*  name;
+	const char** atts;
+	const char*  content;
+	size_t       len;
+} xml_istreamEvent_t;
+
+// batched events reference the batch arena which remains
+// valid until the batch callback returns
+typedef int (*xml_istream_batch_fn)(void* priv, int count,
+                                    const xml_istreamEvent_t* events);
+
+// materialized subtrees are delivered as nodes in document
+// order where the children of a node start at the next node
+// and are linked by next (-1 for the last child) and count
+// is the number of nodes in the subtree of the node
+// names, atts and content reference the tree arena which
+// remains valid until the tree callback returns
+typedef struct
+{
+	int          parent;
+	int          next;
+	int          count;
+	int          line;
+	const char*  name;
+	const char** atts;
+	const char*  content;
+	size_t       len;
+} xml_istreamNode_t;
+
+typedef int (*xml_istream_tree_fn)(void* priv,
+                                   float progress, int count,
+                                   const xml_istreamNode_t* nodes);
+
+// push parsing status
+#define XML_ISTREAM_FEED_ERROR     0
+#define XML_ISTREAM_FEED_OK        1
+#define XML_ISTREAM_FEED_SUSPENDED 2
+
+#define XML_ISTREAM_SUBSCRIBE_MAX_DEPTH 32
+
+typedef struct
+{
+	// path components are separated by '\0'
+	char path[256];
+	int  comp[XML_ISTREAM_SUBSCRIBE_MAX_DEPTH];
+	int  ncomp;
+	int  absolute;
+
+	// number of path components matched by the open elements
+	int matched;
+} xml_istreamSubscription_t;
+
+typedef struct
+{
+	int error;
+
+	float progress;
+
+	// callbacks
+	void* priv;
+	xml_istream_start_fn start_fn;
+	xml_istream_end_fn   end_fn;
+
+	// caller owned stats and the throttled progress callback
+	xml_stats_t*            stats;
+	xml_istream_progress_fn progress_fn;
+	double                  progress_interval;
+	double                  progress_t0;
+	double                  progress_last;
+
+	// buffered content
+	char*  content_buf;
+	size_t content_len;
+	size_t content_size;
+
+	// element depth
+	int depth;
+
+	// added to the expat line number when the parser does
+	// not start at the beginning of the input
+	int line_offset;
+
+	// gzip inflate pipeline
+	int    pipeline_count;
+	size_t pipeline_size;
+
+	// subscriptions and the depth of the subscribed subtree
+	xml_istreamSubscription_t* subs;
+	int                        subs_count;
+	int                        subs_depth;
+
+	// interned names, handlers indexed by id and the ids of
+	// the open elements
+	xml_intern_t*         intern;
+	int                   intern_discover;
+	xml_istreamHandler_t* handlers;
+	int                   handlers_count;
+	int*                  ids;
+	int                   ids_size;
+
+	// parallel parsing
+	int  parallel_threads;
+	int  parallel_ordered;
+	char parallel_record[256];
+
+	// pull parsing input and the pending events where an
+	// empty element produces a start and end event at once
+	int                pull;
+	const char*        pull_buffer;
+	FILE*              pull_file;
+	size_t             pull_offset;
+	size_t             pull_len;
+	int                pull_count;
+	int                pull_index;
+	xml_istreamEvent_t pull_events[2];
+
+	// push parsing input
+	int    push;
+	int    push_suspended;
+	size_t push_offset;
+	size_t push_len;
+
+	// checkpoints are written to checkpoint_fname every
+	// interval bytes at the end of an element along with
+	// the names of the open elements
+	char           checkpoint_fname[256];
+	size_t         checkpoint_interval;
+	size_t         checkpoint_last;
+	int            checkpoint_points;
+	int            checkpoint_restore;
+	int64_t        checkpoint_base;
+	char*          checkpoint_names;
+	size_t         checkpoint_names_len;
+	size_t         checkpoint_names_size;
+	size_t*        checkpoint_stack;
+	int            checkpoint_stack_size;
+	xml_inflate_t* checkpoint_inflate;
+
+	// batched events
+	struct xml_istreamBatch_s* batch;
 
+	// materialized subtrees
+	struct xml_istreamTree_s* tree;
+
+	// skipped subtrees where the fast path suspends the
+	// parser at the start tag (skip_index) of the element
+	// when the subtree extends past the memory passed to
+	// expat (skip_end) and fed is the number of bytes
+	// passed to expat since the parser was reset
+	int         skip_fast;
+	int         skip_depth;
+	int         skip_pending;
+	int         skip_line;
+	int64_t     skip_index;
+	const char* skip_end;
+	int64_t     fed;
+
+	// a callback stopped the parse
+	int stopped;
+
+	// structural scanner backend
+	struct xml_istreamScan_s* scan;
+
+	// concatenated documents
+	int    concat;
+	int    doc_done;
+	size_t doc_end;
+
+	// Expat parser
+	XML_Parser parser;
+} xml_istream_t;
+
+// the istream may be reused to parse many documents which
+// avoids the parser setup and keeps the content buffer
+// start_fn and end_fn may be NULL for pull parsing
+xml_istream_t* xml_istream_new(void* priv,
+                               xml_istream_start_fn start_fn,
+                               xml_istream_end_fn   end_fn);
+void           xml_istream_delete(xml_istream_t** _self);
+int            xml_istream_reset(xml_istream_t* self);
+
+// subscribes to the subtrees of elements matching a name
+// (e.g. "node") or an absolute path (e.g. "/osm/node") where
+// elements outside of the subscribed subtrees are skipped
+// without callbacks or content buffering (by default all
+// elements are delivered)
+int            xml_istream_subscribe(xml_istream_t* self,
+                                     const char* path);
+void           xml_istream_unsubscribe(xml_istream_t* self);
+
+// dispatches elements whose names are in the intern table
+// to the handlers registered for their ids where names that
+// are not in the table are added when discover is set
+// (discover must not be set when the table is shared)
+// elements without a handler use the default callbacks
+void           xml_istream_intern(xml_istream_t* self,
+                                  xml_intern_t* intern,
+                                  int discover);
+int            xml_istream_handler(xml_istream_t* self, int id,
+                                   xml_istream_start_fn start_fn,
+                                   xml_istream_end_fn   end_fn);
+// attribute names are delivered as strings in atts and
+// attrIds fills ids with the interned ids of the names of
+// up to size attributes (-1 for names that are not in the
+// table or without a table) and returns the count
+int            xml_istream_attrIds(xml_istream_t* self,
+                                   const char** atts,
+                                   int* ids, int size);
+
+// fills the caller owned stats while parsing where the
+// stats accumulate across documents until cleared and the
+// phase times are only measured while stats are enabled
+// (stats=NULL disables the stats)
+// the gzip pipeline thread and parallel workers are not
+// included in the stats
+void           xml_istream_stats(xml_istream_t* self,
+                                 xml_stats_t* stats);
+
+// calls progress_fn at most every interval seconds while
+// parsing where returning 0 aborts the parse
+// (progress_fn=NULL disables the callback)
+void           xml_istream_progress(xml_istream_t* self,
+                                    xml_istream_progress_fn progress_fn,
+                                    double interval);
+
+// inflates gzip input on a dedicated thread into a ring of
+// count buffers of size bytes which are parsed by the
+// calling thread (count=0 disables the pipeline)
+int            xml_istream_pipeline(xml_istream_t* self,
+                                    int count, size_t size);
+
+// delivers the events in batches of count events to
+// batch_fn rather than calling the callbacks or handlers
+// where a partial batch is delivered at the end of the
+// document and before a checkpoint is written
+// line numbers are only tracked when lines is set and
+// parallel parsing is disabled while batching
+// batch_fn may return stop while skip is equivalent to
+// continue since the events were already parsed
+// (batch_fn=NULL or count=0 disables batching)
+int            xml_istream_batch(xml_istream_t* self,
+                                 xml_istream_batch_fn batch_fn,
+                                 int count, int lines);
+
+// materializes the subtrees of elements named name which
+// are delivered to tree_fn at the end of the element rather
+// than calling the callbacks for the elements in the subtree
+// (checkpoints are not written inside of a subtree and
+// parallel parsing is disabled while materializing)
+// tree_fn may return stop while skip is equivalent to
+// continue since the subtree was already parsed
+// names may be added until name=NULL clears the names
+int            xml_istream_materialize(xml_istream_t* self,
+                                       const char* name,
+                                       xml_istream_tree_fn tree_fn);
+
+// skipped subtrees of memory and mapped file input are
+// fast-forwarded to the matching end tag by a byte scanner
+// when enabled rather than being parsed by expat without
+// callbacks which requires tracking the names of the open
+// elements (the document must not declare entities since
+// the parser is reset after the subtree)
+void           xml_istream_fastSkip(xml_istream_t* self,
+                                    int enable);
+
+// the structural scanner replaces expat for memory and
+// mapped file input in the subset of UTF-8 documents with
+// ASCII names and without a DTD, CDATA sections, control
+// characters other than tab and newline or entities other
+// than the predefined and character references where the
+// parse falls back to expat at the first construct outside
+// of the subset (including invalid UTF-8)
+int            xml_istream_scanner(xml_istream_t* self,
+                                   int enable);
+
+// read detects gzip, zstd and LZ4 frame input by the magic
+// bytes where zstd and LZ4 require the XML_ISTREAM_ZSTD
+// and XML_ISTREAM_LZ4 build flags (progress is measured
+// by the compressed bytes for zstd and LZ4)
+int            xml_istream_read(xml_istream_t* self,
+                                const char* fname);
+int            xml_istream_readGz(xml_istream_t* self,
+                                  const char* gzname);
+int            xml_istream_readZstd(xml_istream_t* self,
+                                    const char* fname);
+int            xml_istream_readLz4(xml_istream_t* self,
+                                   const char* fname);
+int            xml_istream_readFile(xml_istream_t* self,
+                                    FILE* f, size_t len);
+int            xml_istream_readBuffer(xml_istream_t* self,
+                                      const char* buffer,
+                                      size_t len);
+int            xml_istream_readBufferSlice(xml_istream_t* self,
+                                           const char* buffer,
+                                           size_t len,
+                                           size_t slice);
+
+// parses large flat documents on nthreads by splitting the
+// input at sibling elements named record which must not
+// appear in comments or CDATA, callbacks are delivered in
+// document order when ordered is set otherwise they are
+// delivered concurrently from the worker threads where
+// stop ends the parse once the callbacks which are already
+// running on other workers return (nthreads=0 disables
+// parallel parsing for read and readBuffer)
+int            xml_istream_parallel(xml_istream_t* self,
+                                    const char* record,
+                                    int nthreads, int ordered);
+
+// read and readGz write a checkpoint to fname at the end
+// of an element roughly every interval bytes of input
+// (interval=0 disables checkpoints)
+// restore resumes from the checkpoint in ckname without
+// callbacks for the elements before it or parses from the
+// start when ckname does not exist (restore requires a
+// regular file that may be memory mapped)
+// checkpoints are not written for parallel parsing and
+// readGz does not use the pipeline with checkpoints
+int            xml_istream_checkpoint(xml_istream_t* self,
+                                      const char* fname,
+                                      size_t interval);
+int            xml_istream_restore(xml_istream_t* self,
+                                   const char* fname,
+                                   const char* ckname);
+int            xml_istream_restoreGz(xml_istream_t* self,
+                                     const char* gzname,
+                                     const char* ckname);
+
+// parses gzip input with an index which provides the
+// uncompressed length for progress and starts at the index
+// entry first without callbacks for the root element when
+// first > 0 (first=0 parses the whole file)
+// parallel parsing splits the records at the index entries
+// across the worker threads
+int            xml_istream_readGzIndex(xml_istream_t* self,
+                                       const char* gzname,
+                                       const xml_gzindex_t* index,
+                                       int first);
+
+// parses a buffer of concatenated documents where each
+// document ends with its root element
+int            xml_istream_readConcat(xml_istream_t* self,
+                                      const char* buffer,
+                                      size_t len);
+
+// pull parsing delivers the events returned by next rather
+// than calling the callbacks where the input is parsed
+// lazily as events are requested so that one thread may
+// interleave many documents (len is used for progress and
+// may be 0 when unknown for files)
+// next returns 0 at the end of the document or when an
+// error occurs and the error flag is set
+int            xml_istream_pullBuffer(xml_istream_t* self,
+                                      const char* buffer,
+                                      size_t len);
+int            xml_istream_pullFile(xml_istream_t* self,
+                                    FILE* f, size_t len);
+int            xml_istream_next(xml_istream_t* self,
+                                xml_istreamEvent_t* event);
+
+// push parsing accepts input as it arrives (e.g. from a
+// non-blocking socket) and calls the callbacks from feed
+// where each chunk is passed to expat without an extra
+// copy into XML_GetBuffer
+// (len is used for progress and may be 0 when unknown)
+// a callback may call suspend to apply backpressure which
+// causes feed to return XML_ISTREAM_FEED_SUSPENDED after
+// the parser keeps the unparsed tail of the chunk and the
+// caller must resume before feeding more input
+// feedv stops at a suspension and count receives the
+// number of iovec entries which were accepted
+// finish parses the buffered input and checks that the
+// document is complete
+int            xml_istream_push(xml_istream_t* self,
+                                size_t len);
+int            xml_istream_feed(xml_istream_t* self,
+                                const char* buf,
+                                size_t len);
+int            xml_istream_feedv(xml_istream_t* self,
+                                 const struct iovec* iov,
+                                 int iovcnt, int* _count);
+void           xml_istream_suspend(xml_istream_t* self);
+int            xml_istream_resume(xml_istream_t* self);
+int            xml_istream_finish(xml_istream_t* self);
+
+// the parse functions create a temporary istream
 int xml_istream_parse(void* priv,
                       xml_istream_start_fn start_fn,
                       xml_istream_end_fn   end_fn,
@@ -46,6 +475,14 @@ int xml_istream_parseGz(void* priv,
                         xml_istream_start_fn start_fn,
                         xml_istream_end_fn   end_fn,
                         const char* gzname);
+int xml_istream_parseZstd(void* priv,
+                          xml_istream_start_fn start_fn,
+                          xml_istream_end_fn   end_fn,
+                          const char* fname);
+int xml_istream_parseLz4(void* priv,
+                         xml_istream_start_fn start_fn,
+                         xml_istream_end_fn   end_fn,
+                         const char* fname);
 int xml_istream_parseFile(void* priv,
                           xml_istream_start_fn start_fn,
                           xml_istream_end_fn   end_fn,
@@ -56,4 +493,14 @@ int xml_istream_parseBuffer(void* priv,
                             const char* buffer,
                             size_t len);
 
+// passes the caller owned buffer to expat without an extra
+// copy into XML_GetBuffer where slice is the number of
+// bytes passed to expat between progress updates
+// (parseBuffer uses a 4096 byte slice)
+int xml_istream_parseBufferSlice(void* priv,
+                                 xml_istream_start_fn start_fn,
+                                 xml_istream_end_fn   end_fn,
+                                 const char* buffer,
+                                 size_t len, size_t slice);
+
 #endif
@@ -22,12 +22,26 @@
  */
 
 #include "xml_ostream.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define XML_OSTREAM_AVX2
+	#include <immintrin.h>
+#endif
+
+#ifdef __ARM_NEON
+	#include <arm_neon.h>
+#endif
+
 #define LOG_TAG "xml"
 #include "../libcc/cc_log.h"
 #include "../libcc/cc_memory.h"
@@ -48,10 +62,270 @@
 #define XML_OSTREAM_STATE_CONTENT 3
 #define XML_OSTREAM_STATE_EOF     4
 
+// default output buffer chunk size
+#define XML_OSTREAM_CHUNK_SIZE 65536
+
+// escape table where 0 is copied, 1 is removed (control
+// characters) and otherwise indexes the entity
+static const unsigned char XML_OSTREAM_ESCAPE[256] =
+{
+	[0x00] = 1, [0x01] = 1, [0x02] = 1, [0x03] = 1, [0x04] = 1, [0x05] = 1, [0x06] = 1, [0x07] = 1,
+	[0x08] = 1, [0x09] = 1, [0x0A] = 1, [0x0B] = 1, [0x0C] = 1, [0x0D] = 1, [0x0E] = 1, [0x0F] = 1,
+	[0x10] = 1, [0x11] = 1, [0x12] = 1, [0x13] = 1, [0x14] = 1, [0x15] = 1, [0x16] = 1, [0x17] = 1,
+	[0x18] = 1, [0x19] = 1, [0x1A] = 1, [0x1B] = 1, [0x1C] = 1, [0x1D] = 1, [0x1E] = 1, [0x1F] = 1,
+	['&']  = 2, ['"']  = 3, ['\''] = 4,
+	['<']  = 5, ['>']  = 6,
+};
+
+static const char* XML_OSTREAM_ENTITY[] =
+{
+	"", "", "&amp;", "&quot;", "&apos;", "&lt;", "&gt;",
+};
+
+// xml declaration
+#define XML_OSTREAM_DECL     "<?xml version='1.0' encoding='UTF-8'?>"
+#define XML_OSTREAM_DECL_LEN 38
+
+// indentation is written in chunks of up to 16 tabs
+#define XML_OSTREAM_TABS 16
+
+static const char XML_OSTREAM_TAB_STR[XML_OSTREAM_TABS + 1] =
+	"\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+static void xml_ostream_chunkFree(xml_ostream_t* self)
+{
+	ASSERT(self);
+
+	xml_ostreamBuffer_t* ob = &self->ob;
+
+	int i;
+	for(i = 0; i < ob->iov_count; ++i)
+	{
+		FREE(ob->iov[i].iov_base);
+	}
+	ob->iov_count = 0;
+	ob->size      = 0;
+	ob->len       = 0;
+}
+
+static int xml_ostream_chunkAdd(xml_ostream_t* self)
+{
+	ASSERT(self);
+
+	xml_ostreamBuffer_t* ob = &self->ob;
+
+	if(ob->iov_count == ob->iov_size)
+	{
+		int iov_size = ob->iov_size ? 2*ob->iov_size : 8;
+		struct iovec* iov = (struct iovec*)
+		                    REALLOC(ob->iov,
+		                            iov_size*sizeof(struct iovec));
+		if(iov == NULL)
+		{
+			LOGE("REALLOC failed");
+			self->error = 1;
+			return 0;
+		}
+		ob->iov      = iov;
+		ob->iov_size = iov_size;
+	}
+
+	// the first chunk uses the size hint and the next
+	// chunks double in size
+	size_t size = 2*ob->size;
+	if((ob->iov_count == 0) && ob->hint)
+	{
+		size = ob->hint;
+	}
+	else if(size < XML_OSTREAM_CHUNK_SIZE)
+	{
+		size = XML_OSTREAM_CHUNK_SIZE;
+	}
+
+	// reserve space for the null terminator
+	char* chunk = (char*) MALLOC(size + 1);
+	if(chunk == NULL)
+	{
+		LOGE("MALLOC failed");
+		self->error = 1;
+		return 0;
+	}
+
+	struct iovec* iov = &(ob->iov[ob->iov_count]);
+	iov->iov_base = chunk;
+	iov->iov_len  = 0;
+	ob->size      = size;
+	++ob->iov_count;
+
+	return 1;
+}
+
+static int xml_ostream_chunkJoin(xml_ostream_t* self)
+{
+	ASSERT(self);
+
+	xml_ostreamBuffer_t* ob = &self->ob;
+
+	if(ob->iov_count == 0)
+	{
+		return xml_ostream_chunkAdd(self);
+	}
+	else if(ob->iov_count == 1)
+	{
+		return 1;
+	}
+
+	char* buffer = (char*) MALLOC(ob->len + 1);
+	if(buffer == NULL)
+	{
+		LOGE("MALLOC failed");
+		self->error = 1;
+		return 0;
+	}
+
+	size_t len = 0;
+	int    i;
+	for(i = 0; i < ob->iov_count; ++i)
+	{
+		memcpy(buffer + len, ob->iov[i].iov_base,
+		       ob->iov[i].iov_len);
+		len += ob->iov[i].iov_len;
+	}
+
+	xml_ostream_chunkFree(self);
+	ob->iov[0].iov_base = buffer;
+	ob->iov[0].iov_len  = len;
+	ob->iov_count       = 1;
+	ob->size            = len;
+	ob->len             = len;
+
+	return 1;
+}
+
+static int xml_ostream_output(xml_ostream_t* self,
+                              const char* buf, size_t len)
+{
+	ASSERT(self);
+	ASSERT(buf);
+
+	if(len == 0)
+	{
+		return 1;
+	}
+
+	xml_stats_t* stats = self->stats;
+	double       t0    = stats ? xml_stats_time() : 0.0;
+
+	if(self->mode == XML_OSTREAM_MODE_FILE)
+	{
+		if(fwrite(buf, len*sizeof(char), 1, self->of.f) != 1)
+		{
+			LOGE("fwrite failed");
+			self->error = 1;
+			return 0;
+		}
+
+		if(stats)
+		{
+			stats->time_io += xml_stats_time() - t0;
+		}
+	}
+	else if(self->mode == XML_OSTREAM_MODE_GZFILE)
+	{
+		while(len > 0)
+		{
+			unsigned int n = (len > INT_MAX) ? INT_MAX : len;
+			int bytes_written = gzwrite(self->oz.f, (const void*) buf, n);
+			if(bytes_written == 0)
+			{
+				LOGE("gzwrite failed");
+				self->error = 1;
+				return 0;
+			}
+			buf += bytes_written;
+			len -= bytes_written;
+		}
+
+		if(stats)
+		{
+			stats->time_io += xml_stats_time() - t0;
+		}
+	}
+	else
+	{
+		// fill the last chunk and add chunks as needed
+		xml_ostreamBuffer_t* ob = &self->ob;
+		while(len > 0)
+		{
+			struct iovec* iov = NULL;
+			if(ob->iov_count)
+			{
+				iov = &(ob->iov[ob->iov_count - 1]);
+			}
+
+			if((iov == NULL) || (iov->iov_len == ob->size))
+			{
+				if(xml_ostream_chunkAdd(self) == 0)
+				{
+					return 0;
+				}
+
+				if(stats)
+				{
+					++stats->allocs;
+				}
+				continue;
+			}
+
+			size_t n = ob->size - iov->iov_len;
+			if(n > len)
+			{
+				n = len;
+			}
+
+			char* dst = (char*) iov->iov_base;
+			memcpy(dst + iov->iov_len, buf, n);
+			iov->iov_len += n;
+			ob->len      += n;
+			buf          += n;
+			len          -= n;
+		}
+
+		if(stats)
+		{
+			stats->time_alloc += xml_stats_time() - t0;
+			if(ob->len > stats->peak_buffer)
+			{
+				stats->peak_buffer = ob->len;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int xml_ostream_flush(xml_ostream_t* self)
+{
+	ASSERT(self);
+
+	// ignore flush on error
+	if(self->error)
+	{
+		return 0;
+	}
+
+	int len = self->wlen;
+	self->wlen = 0;
+	return xml_ostream_output(self, self->wbuf, len);
+}
+
 static void xml_ostream_close(xml_ostream_t* self)
 {
 	ASSERT(self);
 
+	// the buffered output is lost on error
+	xml_ostream_flush(self);
+
 	if((self->mode == XML_OSTREAM_MODE_FILE) &&
 	   self->of.close)
 	{
@@ -88,8 +362,8 @@ static void xml_ostream_close(xml_ostream_t* self)
 	}
 }
 
-static int xml_ostream_write(xml_ostream_t* self,
-                             const char* buf)
+static int xml_ostream_writen(xml_ostream_t* self,
+                              const char* buf, size_t len)
 {
 	ASSERT(self);
 	ASSERT(buf);
@@ -100,81 +374,62 @@ static int xml_ostream_write(xml_ostream_t* self,
 		return 0;
 	}
 
-	int len = strlen(buf);
-	if(self->mode == XML_OSTREAM_MODE_FILE)
+	if(self->stats)
 	{
-		if(fwrite(buf, len*sizeof(char), 1, self->of.f) != 1)
-		{
-			LOGE("fwrite failed");
-			self->error = 1;
-			return 0;
-		}
+		self->stats->bytes += len;
 	}
-	else if(self->mode == XML_OSTREAM_MODE_GZFILE)
+
+	// append to the write buffer when possible
+	if(len <= (size_t) (XML_OSTREAM_WBUF_SIZE - self->wlen))
 	{
-		while(len > 0)
-		{
-			int bytes_written = gzwrite(self->oz.f, (const void*) buf, len);
-			if(bytes_written == 0)
-			{
-				LOGE("gzwrite failed");
-				self->error = 1;
-				return 0;
-			}
-			buf += bytes_written;
-			len -= bytes_written;
-		}
+		memcpy(&(self->wbuf[self->wlen]), buf, len);
+		self->wlen += len;
+		return 1;
 	}
-	else
+
+	if(xml_ostream_flush(self) == 0)
 	{
-		int len2  = len + self->ob.len;
-		int len21 = len2 + 1;
-		char* buffer = (char*)
-		               REALLOC(self->ob.buffer,
-		                       len21*sizeof(char));
-		if(buffer == NULL)
-		{
-			LOGE("relloc failed");
-			self->error = 1;
-			return 0;
-		}
-		self->ob.buffer = buffer;
+		return 0;
+	}
 
-		char* dst = &(self->ob.buffer[self->ob.len]);
-		memcpy(dst, buf, len);
-		self->ob.buffer[len2] = '\0';
-		self->ob.len = len2;
+	// large writes bypass the write buffer
+	if(len >= XML_OSTREAM_WBUF_SIZE)
+	{
+		return xml_ostream_output(self, buf, len);
 	}
 
+	memcpy(self->wbuf, buf, len);
+	self->wlen = len;
 	return 1;
 }
 
-static int xml_ostream_writef(xml_ostream_t* self,
-                              const char* fmt, ...)
+static int xml_ostream_write(xml_ostream_t* self,
+                             const char* buf)
 {
 	ASSERT(self);
-	ASSERT(fmt);
-
-	char buf[256];
-	va_list argptr;
-	va_start(argptr, fmt);
-	vsnprintf(buf, 256, fmt, argptr);
-	va_end(argptr);
+	ASSERT(buf);
 
-	return xml_ostream_write(self, buf);
+	return xml_ostream_writen(self, buf, strlen(buf));
 }
 
 static int xml_ostream_indent(xml_ostream_t* self)
 {
 	ASSERT(self);
 
-	int i;
-	for(i = 0; i < self->depth; ++i)
+	int depth = self->depth;
+	while(depth > 0)
 	{
-		if(xml_ostream_write(self, "\t") == 0)
+		int n = depth;
+		if(n > XML_OSTREAM_TABS)
+		{
+			n = XML_OSTREAM_TABS;
+		}
+
+		if(xml_ostream_writen(self, XML_OSTREAM_TAB_STR, n) == 0)
 		{
 			return 0;
 		}
+		depth -= n;
 	}
 
 	return 1;
@@ -184,144 +439,336 @@ static int xml_ostream_endln(xml_ostream_t* self)
 {
 	ASSERT(self);
 
-	return xml_ostream_write(self, "\n");
+	return xml_ostream_writen(self, "\n", 1);
+}
+
+// writes the open (<name) or close (</name>) tag of the
+// current element
+static int xml_ostream_writeTag(xml_ostream_t* self,
+                                int close)
+{
+	ASSERT(self);
+	ASSERT(self->elems_count > 0);
+
+	size_t      offset = self->elems[self->elems_count - 1];
+	const char* name   = &(self->names[offset]);
+	size_t      len    = self->names_len - offset - 1;
+	if(close)
+	{
+		return xml_ostream_writen(self, "</", 2)    &&
+		       xml_ostream_writen(self, name, len) &&
+		       xml_ostream_writen(self, ">", 1);
+	}
+
+	return xml_ostream_writen(self, "<", 1) &&
+	       xml_ostream_writen(self, name, len);
 }
 
-static int xml_ostream_filter(xml_ostream_t* self,
-                              const char* a,
-                              char* b)
+// the scan kernels return the index of the first byte
+// which must be removed or escaped (or len when none)
+
+static size_t
+xml_ostream_scanScalar(const unsigned char* p, size_t len)
 {
-	ASSERT(a);
-	ASSERT(b);
+	ASSERT(p);
 
-	// initialize b
-	b[0] = '\0';
+	size_t i = 0;
+	while((i < len) && (XML_OSTREAM_ESCAPE[p[i]] == 0))
+	{
+		++i;
+	}
+	return i;
+}
 
-	int i   = 0;
-	int len = 0;
-	while(1)
+#ifdef __SSE2__
+static size_t
+xml_ostream_scanSSE2(const unsigned char* p, size_t len)
+{
+	ASSERT(p);
+
+	const __m128i ctl  = _mm_set1_epi8(0x1F);
+	const __m128i amp  = _mm_set1_epi8('&');
+	const __m128i quot = _mm_set1_epi8('"');
+	const __m128i apos = _mm_set1_epi8('\'');
+	const __m128i lt   = _mm_set1_epi8('<');
+	const __m128i gt   = _mm_set1_epi8('>');
+
+	size_t i = 0;
+	for(; i + 16 <= len; i += 16)
 	{
-		// eat invalid characters
-		if((a[i] == '\n') ||
-		   (a[i] == '\t') ||
-		   (a[i] == '\r'))
+		__m128i v = _mm_loadu_si128((const __m128i*) &p[i]);
+
+		// v <= 0x1F is computed as min(v, 0x1F) == v
+		__m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v);
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, amp));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, quot));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, apos));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, lt));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, gt));
+
+		int mask = _mm_movemask_epi8(m);
+		if(mask)
 		{
-			++i;
-			continue;
+			return i + __builtin_ctz(mask);
 		}
+	}
+
+	return i + xml_ostream_scanScalar(&p[i], len - i);
+}
+#endif
 
-		// check for word boundary
-		if(a[i] == '\0')
+#ifdef XML_OSTREAM_AVX2
+__attribute__((target("avx2")))
+static size_t
+xml_ostream_scanAVX2(const unsigned char* p, size_t len)
+{
+	ASSERT(p);
+
+	const __m256i ctl  = _mm256_set1_epi8(0x1F);
+	const __m256i amp  = _mm256_set1_epi8('&');
+	const __m256i quot = _mm256_set1_epi8('"');
+	const __m256i apos = _mm256_set1_epi8('\'');
+	const __m256i lt   = _mm256_set1_epi8('<');
+	const __m256i gt   = _mm256_set1_epi8('>');
+
+	size_t i = 0;
+	for(; i + 32 <= len; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) &p[i]);
+
+		__m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v);
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, amp));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, quot));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, apos));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, lt));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, gt));
+
+		unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+		if(mask)
 		{
-			return 1;
+			return i + __builtin_ctz(mask);
 		}
+	}
 
-		if(a[i] == '&')
-		{
-			if((len + 5) >= 256)
-			{
-				LOGE("invalid %s", a);
-				self->error = 1;
-				return 0;
-			}
+	#ifdef __SSE2__
+		return i + xml_ostream_scanSSE2(&p[i], len - i);
+	#else
+		return i + xml_ostream_scanScalar(&p[i], len - i);
+	#endif
+}
+#endif
 
-			b[len]     = '&';
-			b[len + 1] = 'a';
-			b[len + 2] = 'm';
-			b[len + 3] = 'p';
-			b[len + 4] = ';';
-			b[len + 5] = '\0';
-			len += 5;
-			++i;
-		}
-		else if(a[i] == '"')
-		{
-			if((len + 6) >= 256)
-			{
-				LOGE("invalid %s", a);
-				self->error = 1;
-				return 0;
-			}
+#ifdef __ARM_NEON
+static size_t
+xml_ostream_scanNEON(const unsigned char* p, size_t len)
+{
+	ASSERT(p);
 
-			b[len]     = '&';
-			b[len + 1] = 'q';
-			b[len + 2] = 'u';
-			b[len + 3] = 'o';
-			b[len + 4] = 't';
-			b[len + 5] = ';';
-			b[len + 6] = '\0';
-			len += 6;
-			++i;
-		}
-		else if(a[i] == '\'')
+	const uint8x16_t ctl  = vdupq_n_u8(0x20);
+	const uint8x16_t amp  = vdupq_n_u8('&');
+	const uint8x16_t quot = vdupq_n_u8('"');
+	const uint8x16_t apos = vdupq_n_u8('\'');
+	const uint8x16_t lt   = vdupq_n_u8('<');
+	const uint8x16_t gt   = vdupq_n_u8('>');
+
+	size_t i = 0;
+	for(; i + 16 <= len; i += 16)
+	{
+		uint8x16_t v = vld1q_u8(&p[i]);
+
+		uint8x16_t m = vcltq_u8(v, ctl);
+		m = vorrq_u8(m, vceqq_u8(v, amp));
+		m = vorrq_u8(m, vceqq_u8(v, quot));
+		m = vorrq_u8(m, vceqq_u8(v, apos));
+		m = vorrq_u8(m, vceqq_u8(v, lt));
+		m = vorrq_u8(m, vceqq_u8(v, gt));
+
+		// narrow the byte mask to a nibble per byte
+		uint8x8_t n    = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+		uint64_t  mask = vget_lane_u64(vreinterpret_u64_u8(n), 0);
+		if(mask)
 		{
-			if((len + 6) >= 256)
+			return i + (__builtin_ctzll(mask) >> 2);
+		}
+	}
+
+	return i + xml_ostream_scanScalar(&p[i], len - i);
+}
+#endif
+
+typedef size_t (*xml_ostream_scan_fn)(const unsigned char* p,
+                                     size_t len);
+
+// returns the scan function of a kernel where auto selects
+// the fastest kernel supported by the cpu (or NULL when the
+// kernel is not supported)
+static xml_ostream_scan_fn xml_ostream_kernelFn(int kernel)
+{
+	if(kernel == XML_OSTREAM_KERNEL_AUTO)
+	{
+		#if defined(__SSE2__)
+			kernel = XML_OSTREAM_KERNEL_SSE2;
+		#elif defined(__ARM_NEON)
+			kernel = XML_OSTREAM_KERNEL_NEON;
+		#else
+			kernel = XML_OSTREAM_KERNEL_SCALAR;
+		#endif
+
+		#ifdef XML_OSTREAM_AVX2
+			if(__builtin_cpu_supports("avx2"))
 			{
-				LOGE("invalid %s", a);
-				self->error = 1;
-				return 0;
+				kernel = XML_OSTREAM_KERNEL_AVX2;
 			}
+		#endif
+	}
 
-			b[len]     = '&';
-			b[len + 1] = 'a';
-			b[len + 2] = 'p';
-			b[len + 3] = 'o';
-			b[len + 4] = 's';
-			b[len + 5] = ';';
-			b[len + 6] = '\0';
-			len += 6;
-			++i;
+	if(kernel == XML_OSTREAM_KERNEL_SCALAR)
+	{
+		return xml_ostream_scanScalar;
+	}
+
+	#ifdef XML_OSTREAM_AVX2
+		if((kernel == XML_OSTREAM_KERNEL_AVX2) &&
+		   __builtin_cpu_supports("avx2"))
+		{
+			return xml_ostream_scanAVX2;
 		}
-		else if(a[i] == '<')
+	#endif
+
+	#ifdef __SSE2__
+		if(kernel == XML_OSTREAM_KERNEL_SSE2)
 		{
-			if((len + 4) >= 256)
-			{
-				LOGE("invalid %s", a);
-				self->error = 1;
-				return 0;
-			}
+			return xml_ostream_scanSSE2;
+		}
+	#endif
 
-			b[len]     = '&';
-			b[len + 1] = 'l';
-			b[len + 2] = 't';
-			b[len + 3] = ';';
-			b[len + 4] = '\0';
-			len += 4;
-			++i;
+	#ifdef __ARM_NEON
+		if(kernel == XML_OSTREAM_KERNEL_NEON)
+		{
+			return xml_ostream_scanNEON;
 		}
-		else if(a[i] == '>')
+	#endif
+
+	return NULL;
+}
+
+static size_t
+xml_ostream_scanInit(const unsigned char* p, size_t len);
+
+// selected scan function which resolves the auto kernel
+// on first use
+static xml_ostream_scan_fn xml_ostream_scan = xml_ostream_scanInit;
+
+static size_t
+xml_ostream_scanInit(const unsigned char* p, size_t len)
+{
+	ASSERT(p);
+
+	xml_ostream_scan_fn scan;
+	scan = xml_ostream_kernelFn(XML_OSTREAM_KERNEL_AUTO);
+	__atomic_store_n(&xml_ostream_scan, scan, __ATOMIC_RELAXED);
+	return scan(p, len);
+}
+
+// escapes the value directly into the output where
+// control characters are removed and the special
+// characters are replaced by their entities
+static int xml_ostream_escape(xml_ostream_t* self,
+                              const char* val, size_t len)
+{
+	ASSERT(self);
+	ASSERT(val);
+
+	const unsigned char* p = (const unsigned char*) val;
+
+	xml_ostream_scan_fn scan;
+	scan = __atomic_load_n(&xml_ostream_scan, __ATOMIC_RELAXED);
+
+	// copy the runs between the special characters
+	size_t run = 0;
+	size_t i   = 0;
+	while(1)
+	{
+		i += scan(&p[i], len - i);
+		if(i >= len)
 		{
-			if((len + 4) >= 256)
-			{
-				LOGE("invalid %s", a);
-				self->error = 1;
-				return 0;
-			}
+			break;
+		}
 
-			b[len]     = '&';
-			b[len + 1] = 'g';
-			b[len + 2] = 't';
-			b[len + 3] = ';';
-			b[len + 4] = '\0';
-			len += 4;
-			++i;
+		if(xml_ostream_writen(self, &val[run], i - run) == 0)
+		{
+			return 0;
 		}
-		else
+
+		unsigned char c = XML_OSTREAM_ESCAPE[p[i]];
+		if(c > 1)
 		{
-			if((len + 1) >= 256)
+			const char* entity = XML_OSTREAM_ENTITY[c];
+			if(xml_ostream_write(self, entity) == 0)
 			{
-				LOGE("invalid %s", a);
-				self->error = 1;
 				return 0;
 			}
-
-			// append character to word
-			b[len]     = a[i];
-			b[len + 1] = '\0';
-			++len;
-			++i;
 		}
+
+		++i;
+		run = i;
 	}
+
+	return xml_ostream_writen(self, &val[run], len - run);
+}
+
+// formats into buf when the result fits in 256 bytes and
+// otherwise into an allocated buffer which must be freed
+// by the caller when not equal to buf
+static char* xml_ostream_format(xml_ostream_t* self,
+                                char* buf, size_t* _len,
+                                const char* fmt,
+                                va_list argptr)
+{
+	ASSERT(self);
+	ASSERT(buf);
+	ASSERT(_len);
+	ASSERT(fmt);
+
+	va_list argptr2;
+	va_copy(argptr2, argptr);
+
+	int len = vsnprintf(buf, 256, fmt, argptr);
+	if(len < 0)
+	{
+		LOGE("invalid fmt=%s", fmt);
+		goto fail_format;
+	}
+	else if(len < 256)
+	{
+		va_end(argptr2);
+		*_len = (size_t) len;
+		return buf;
+	}
+
+	char* val = (char*) MALLOC(len + 1);
+	if(val == NULL)
+	{
+		LOGE("MALLOC failed");
+		goto fail_format;
+	}
+	vsnprintf(val, len + 1, fmt, argptr2);
+	va_end(argptr2);
+
+	if(self->stats)
+	{
+		++self->stats->allocs;
+	}
+
+	// success
+	*_len = (size_t) len;
+	return val;
+
+	// failure
+	fail_format:
+		va_end(argptr2);
+		self->error = 1;
+	return NULL;
 }
 
 static int xml_ostream_elemPush(xml_ostream_t* self,
@@ -330,18 +777,72 @@ static int xml_ostream_elemPush(xml_ostream_t* self,
 	ASSERT(self);
 	ASSERT(name);
 
-	xml_ostreamElem_t* elem = (xml_ostreamElem_t*)
-	                          MALLOC(sizeof(xml_ostreamElem_t));
-	if(elem == NULL)
+	xml_stats_t* stats = self->stats;
+	double       t0    = stats ? xml_stats_time() : 0.0;
+
+	// grow the element offsets
+	if(self->elems_count == self->elems_size)
 	{
-		LOGE("MALLOC failed");
-		self->error = 1;
-		return 0;
+		int elems_size = self->elems_size ? 2*self->elems_size : 16;
+		size_t* elems = (size_t*)
+		                REALLOC(self->elems,
+		                        elems_size*sizeof(size_t));
+		if(elems == NULL)
+		{
+			LOGE("REALLOC failed");
+			self->error = 1;
+			return 0;
+		}
+		self->elems      = elems;
+		self->elems_size = elems_size;
+
+		if(stats)
+		{
+			++stats->allocs;
+		}
 	}
 
-	snprintf(elem->name, 256, "%s", name);
-	elem->next = self->elem;
-	self->elem = elem;
+	// grow the names arena
+	size_t len = strlen(name) + 1;
+	if(self->names_len + len > self->names_size)
+	{
+		size_t names_size = self->names_size ? 2*self->names_size : 1024;
+		while(self->names_len + len > names_size)
+		{
+			names_size *= 2;
+		}
+
+		char* names = (char*) REALLOC(self->names, names_size);
+		if(names == NULL)
+		{
+			LOGE("REALLOC failed");
+			self->error = 1;
+			return 0;
+		}
+		self->names      = names;
+		self->names_size = names_size;
+
+		if(stats)
+		{
+			++stats->allocs;
+		}
+	}
+
+	// the element is pushed before the depth is incremented
+	if(stats)
+	{
+		stats->time_alloc += xml_stats_time() - t0;
+		++stats->events;
+		if((self->depth + 1) > stats->max_depth)
+		{
+			stats->max_depth = self->depth + 1;
+		}
+	}
+
+	memcpy(&(self->names[self->names_len]), name, len);
+	self->elems[self->elems_count] = self->names_len;
+	self->names_len += len;
+	++self->elems_count;
 	return 1;
 }
 
@@ -349,11 +850,10 @@ static void xml_ostream_elemPop(xml_ostream_t* self)
 {
 	ASSERT(self);
 
-	if(self->elem)
+	if(self->elems_count)
 	{
-		xml_ostreamElem_t* elem = self->elem;
-		self->elem = self->elem->next;
-		FREE(elem);
+		--self->elems_count;
+		self->names_len = self->elems[self->elems_count];
 	}
 }
 
@@ -361,9 +861,9 @@ static const char* xml_ostream_elemPeek(xml_ostream_t* self)
 {
 	ASSERT(self);
 
-	if(self->elem)
+	if(self->elems_count)
 	{
-		return self->elem->name;
+		return &(self->names[self->elems[self->elems_count - 1]]);
 	}
 
 	return NULL;
@@ -396,13 +896,20 @@ xml_ostream_t* xml_ostream_new(const char* fname)
 		goto fail_fopen;
 	}
 
-	self->mode     = XML_OSTREAM_MODE_FILE;
-	self->state    = XML_OSTREAM_STATE_INIT;
-	self->error    = 0;
-	self->depth    = 0;
-	self->elem     = NULL;
-	self->of.f     = f;
-	self->of.close = 1;
+	self->mode        = XML_OSTREAM_MODE_FILE;
+	self->state       = XML_OSTREAM_STATE_INIT;
+	self->error       = 0;
+	self->depth       = 0;
+	self->names       = NULL;
+	self->names_len   = 0;
+	self->names_size  = 0;
+	self->elems       = NULL;
+	self->elems_count = 0;
+	self->elems_size  = 0;
+	self->stats       = NULL;
+	self->wlen        = 0;
+	self->of.f        = f;
+	self->of.close    = 1;
 
 	// success
 	return self;
@@ -436,13 +943,20 @@ xml_ostream_t* xml_ostream_newGz(const char* gzname)
 		goto fail_gzopen;
 	}
 
-	self->mode     = XML_OSTREAM_MODE_GZFILE;
-	self->state    = XML_OSTREAM_STATE_INIT;
-	self->error    = 0;
-	self->depth    = 0;
-	self->elem     = NULL;
-	self->oz.f     = f;
-	self->oz.close = 1;
+	self->mode        = XML_OSTREAM_MODE_GZFILE;
+	self->state       = XML_OSTREAM_STATE_INIT;
+	self->error       = 0;
+	self->depth       = 0;
+	self->names       = NULL;
+	self->names_len   = 0;
+	self->names_size  = 0;
+	self->elems       = NULL;
+	self->elems_count = 0;
+	self->elems_size  = 0;
+	self->stats       = NULL;
+	self->wlen        = 0;
+	self->oz.f        = f;
+	self->oz.close    = 1;
 
 	// success
 	return self;
@@ -465,18 +979,30 @@ xml_ostream_t* xml_ostream_newFile(FILE* f)
 		return NULL;
 	}
 
-	self->mode     = XML_OSTREAM_MODE_FILE;
-	self->state    = XML_OSTREAM_STATE_INIT;
-	self->error    = 0;
-	self->depth    = 0;
-	self->elem     = NULL;
-	self->of.f     = f;
-	self->of.close = 0;
+	self->mode        = XML_OSTREAM_MODE_FILE;
+	self->state       = XML_OSTREAM_STATE_INIT;
+	self->error       = 0;
+	self->depth       = 0;
+	self->names       = NULL;
+	self->names_len   = 0;
+	self->names_size  = 0;
+	self->elems       = NULL;
+	self->elems_count = 0;
+	self->elems_size  = 0;
+	self->stats       = NULL;
+	self->wlen        = 0;
+	self->of.f        = f;
+	self->of.close    = 0;
 
 	return self;
 }
 
 xml_ostream_t* xml_ostream_newBuffer(void)
+{
+	return xml_ostream_newBufferHint(0);
+}
+
+xml_ostream_t* xml_ostream_newBufferHint(size_t size_hint)
 {
 	xml_ostream_t* self = (xml_ostream_t*)
 	                      MALLOC(sizeof(xml_ostream_t));
@@ -486,13 +1012,24 @@ xml_ostream_t* xml_ostream_newBuffer(void)
 		return NULL;
 	}
 
-	self->mode      = XML_OSTREAM_MODE_BUFFER;
-	self->state     = XML_OSTREAM_STATE_INIT;
-	self->error     = 0;
-	self->depth     = 0;
-	self->elem      = NULL;
-	self->ob.buffer = NULL;
-	self->ob.len    = 0;
+	self->mode         = XML_OSTREAM_MODE_BUFFER;
+	self->state        = XML_OSTREAM_STATE_INIT;
+	self->error        = 0;
+	self->depth        = 0;
+	self->names        = NULL;
+	self->names_len    = 0;
+	self->names_size   = 0;
+	self->elems        = NULL;
+	self->elems_count  = 0;
+	self->elems_size   = 0;
+	self->stats        = NULL;
+	self->wlen         = 0;
+	self->ob.iov       = NULL;
+	self->ob.iov_count = 0;
+	self->ob.iov_size  = 0;
+	self->ob.size      = 0;
+	self->ob.hint      = size_hint;
+	self->ob.len       = 0;
 
 	return self;
 }
@@ -506,23 +1043,49 @@ void xml_ostream_delete(xml_ostream_t** _self)
 	{
 		if(self->mode == XML_OSTREAM_MODE_BUFFER)
 		{
-			FREE(self->ob.buffer);
+			xml_ostream_chunkFree(self);
+			FREE(self->ob.iov);
 		}
 		else
 		{
 			xml_ostream_close(self);
 		}
 
-		while(self->elem)
-		{
-			xml_ostream_elemPop(self);
-		}
+		FREE(self->names);
+		FREE(self->elems);
 
 		FREE(self);
 		*_self = NULL;
 	}
 }
 
+void xml_ostream_stats(xml_ostream_t* self,
+                       xml_stats_t* stats)
+{
+	ASSERT(self);
+
+	// stats may be NULL when disabled
+	self->stats = stats;
+}
+
+int xml_ostream_kernel(int kernel)
+{
+	xml_ostream_scan_fn scan = xml_ostream_kernelFn(kernel);
+	if(scan == NULL)
+	{
+		LOGE("unsupported kernel=%i", kernel);
+		return 0;
+	}
+
+	__atomic_store_n(&xml_ostream_scan, scan, __ATOMIC_RELAXED);
+	return 1;
+}
+
+int xml_ostream_kernelSupported(int kernel)
+{
+	return xml_ostream_kernelFn(kernel) ? 1 : 0;
+}
+
 int xml_ostream_begin(xml_ostream_t* self,
                       const char* name)
 {
@@ -531,7 +1094,8 @@ int xml_ostream_begin(xml_ostream_t* self,
 
 	if(self->state == XML_OSTREAM_STATE_INIT)
 	{
-		if(xml_ostream_write(self, "<?xml version='1.0' encoding='UTF-8'?>") == 0)
+		if(xml_ostream_writen(self, XML_OSTREAM_DECL,
+		                      XML_OSTREAM_DECL_LEN) == 0)
 		{
 			return 0;
 		}
@@ -545,7 +1109,7 @@ int xml_ostream_begin(xml_ostream_t* self,
 	if(self->state == XML_OSTREAM_STATE_INIT)
 	{
 		if(xml_ostream_endln(self) &&
-		   xml_ostream_writef(self, "<%s", name))
+		   xml_ostream_writeTag(self, 0))
 		{
 			self->state = XML_OSTREAM_STATE_BODY;
 			++self->depth;
@@ -554,10 +1118,10 @@ int xml_ostream_begin(xml_ostream_t* self,
 	}
 	else if(self->state == XML_OSTREAM_STATE_BODY)
 	{
-		if(xml_ostream_write(self, ">") &&
-		   xml_ostream_endln(self)      &&
-		   xml_ostream_indent(self)     &&
-		   xml_ostream_writef(self, "<%s", name))
+		if(xml_ostream_writen(self, ">", 1) &&
+		   xml_ostream_endln(self)          &&
+		   xml_ostream_indent(self)         &&
+		   xml_ostream_writeTag(self, 0))
 		{
 			++self->depth;
 			return 1;
@@ -567,7 +1131,7 @@ int xml_ostream_begin(xml_ostream_t* self,
 	{
 		if(xml_ostream_endln(self)  &&
 		   xml_ostream_indent(self) &&
-		   xml_ostream_writef(self, "<%s", name))
+		   xml_ostream_writeTag(self, 0))
 		{
 			self->state = XML_OSTREAM_STATE_BODY;
 			++self->depth;
@@ -596,6 +1160,11 @@ int xml_ostream_end(xml_ostream_t* self)
 		return 0;
 	}
 
+	if(self->stats)
+	{
+		++self->stats->events;
+	}
+
 	if(self->state == XML_OSTREAM_STATE_BODY)
 	{
 		--self->depth;
@@ -608,7 +1177,7 @@ int xml_ostream_end(xml_ostream_t* self)
 			self->state = XML_OSTREAM_STATE_NESTED;
 		}
 
-		if(xml_ostream_write(self, " />"))
+		if(xml_ostream_writen(self, " />", 3))
 		{
 			xml_ostream_elemPop(self);
 			return 1;
@@ -624,7 +1193,7 @@ int xml_ostream_end(xml_ostream_t* self)
 
 		if(xml_ostream_endln(self)  &&
 		   xml_ostream_indent(self) &&
-		   xml_ostream_writef(self, "</%s>", name))
+		   xml_ostream_writeTag(self, 1))
 		{
 			xml_ostream_elemPop(self);
 			return 1;
@@ -642,7 +1211,7 @@ int xml_ostream_end(xml_ostream_t* self)
 			self->state = XML_OSTREAM_STATE_NESTED;
 		}
 
-		if(xml_ostream_writef(self, "</%s>", name))
+		if(xml_ostream_writeTag(self, 1))
 		{
 			xml_ostream_elemPop(self);
 			return 1;
@@ -665,12 +1234,24 @@ int xml_ostream_attr(xml_ostream_t* self,
 	ASSERT(name);
 	ASSERT(val);
 
+	return xml_ostream_attrn(self, name, val, strlen(val));
+}
+
+int xml_ostream_attrn(xml_ostream_t* self,
+                      const char* name,
+                      const char* val, size_t len)
+{
+	ASSERT(self);
+	ASSERT(name);
+	ASSERT(val);
+
 	if(self->state == XML_OSTREAM_STATE_BODY)
 	{
-		char val2[256];
-		xml_ostream_filter(self, val, val2);
-		return xml_ostream_writef(self, " %s=\"%s\"",
-		                          name, val2);
+		return xml_ostream_writen(self, " ", 1)   &&
+		       xml_ostream_write(self, name)      &&
+		       xml_ostream_writen(self, "=\"", 2) &&
+		       xml_ostream_escape(self, val, len) &&
+		       xml_ostream_writen(self, "\"", 1);
 	}
 	else
 	{
@@ -688,13 +1269,25 @@ int xml_ostream_attrf(xml_ostream_t* self,
 	ASSERT(name);
 	ASSERT(fmt);
 
-	char val[256];
+	char    buf[256];
+	size_t  len;
 	va_list argptr;
 	va_start(argptr, fmt);
-	vsnprintf(val, 256, fmt, argptr);
+	char* val = xml_ostream_format(self, buf, &len,
+	                               fmt, argptr);
 	va_end(argptr);
 
-	return xml_ostream_attr(self, name, val);
+	if(val == NULL)
+	{
+		return 0;
+	}
+
+	int ret = xml_ostream_attrn(self, name, val, len);
+	if(val != buf)
+	{
+		FREE(val);
+	}
+	return ret;
 }
 
 int xml_ostream_content(xml_ostream_t* self,
@@ -703,23 +1296,30 @@ int xml_ostream_content(xml_ostream_t* self,
 	ASSERT(self);
 	ASSERT(content);
 
-	// filter the content
-	char filtered[256];
-	xml_ostream_filter(self, content, filtered);
+	return xml_ostream_contentn(self, content,
+	                            strlen(content));
+}
+
+int xml_ostream_contentn(xml_ostream_t* self,
+                         const char* content,
+                         size_t len)
+{
+	ASSERT(self);
+	ASSERT(content);
 
 	if(self->state == XML_OSTREAM_STATE_BODY)
 	{
 		self->state = XML_OSTREAM_STATE_CONTENT;
 
-		if(xml_ostream_write(self, ">") &&
-		   xml_ostream_write(self, filtered))
+		if(xml_ostream_writen(self, ">", 1) &&
+		   xml_ostream_escape(self, content, len))
 		{
 			return 1;
 		}
 	}
 	else if(self->state == XML_OSTREAM_STATE_CONTENT)
 	{
-		if(xml_ostream_write(self, filtered))
+		if(xml_ostream_escape(self, content, len))
 		{
 			return 1;
 		}
@@ -739,13 +1339,25 @@ int xml_ostream_contentf(xml_ostream_t* self,
 	ASSERT(self);
 	ASSERT(fmt);
 
-	char val[256];
+	char    buf[256];
+	size_t  len;
 	va_list argptr;
 	va_start(argptr, fmt);
-	vsnprintf(val, 256, fmt, argptr);
+	char* val = xml_ostream_format(self, buf, &len,
+	                               fmt, argptr);
 	va_end(argptr);
 
-	return xml_ostream_content(self, val);
+	if(val == NULL)
+	{
+		return 0;
+	}
+
+	int ret = xml_ostream_contentn(self, val, len);
+	if(val != buf)
+	{
+		FREE(val);
+	}
+	return ret;
 }
 
 const char* xml_ostream_buffer(xml_ostream_t* self,
@@ -755,17 +1367,60 @@ const char* xml_ostream_buffer(xml_ostream_t* self,
 	ASSERT(self);
 	ASSERT(len);
 
+	if((xml_ostream_complete(self) == 0) ||
+	   (self->mode != XML_OSTREAM_MODE_BUFFER))
+	{
+		return NULL;
+	}
+
+	xml_ostreamBuffer_t* ob = &self->ob;
+	if(ob->len > INT_MAX)
+	{
+		LOGE("invalid len=%lu", (unsigned long) ob->len);
+		return NULL;
+	}
+
+	xml_stats_t* stats = self->stats;
+	double       t0    = stats ? xml_stats_time() : 0.0;
+
+	int count = ob->iov_count;
+	if(xml_ostream_chunkJoin(self) == 0)
+	{
+		return NULL;
+	}
+
+	if(stats && (count != 1))
+	{
+		stats->time_alloc += xml_stats_time() - t0;
+		++stats->allocs;
+	}
+
+	char* buffer = (char*) ob->iov[0].iov_base;
+	buffer[ob->len] = '\0';
+	*len = (int) ob->len;
+	if(acquire)
+	{
+		ob->iov_count = 0;
+		ob->size      = 0;
+		ob->len       = 0;
+	}
+	return buffer;
+}
+
+const struct iovec*
+xml_ostream_iovec(xml_ostream_t* self, int* count,
+                  size_t* len)
+{
+	ASSERT(self);
+	ASSERT(count);
+	ASSERT(len);
+
 	if(xml_ostream_complete(self) &&
 	   (self->mode == XML_OSTREAM_MODE_BUFFER))
 	{
-		*len = self->ob.len;
-		char* buffer = self->ob.buffer;
-		if(acquire)
-		{
-			self->ob.len    = 0;
-			self->ob.buffer = NULL;
-		}
-		return buffer;
+		*count = self->ob.iov_count;
+		*len   = self->ob.len;
+		return self->ob.iov;
 	}
 	else
 	{
@@ -785,3 +1440,38 @@ int xml_ostream_complete(xml_ostream_t* self)
 
 	return 0;
 }
+
+int xml_ostream_reset(xml_ostream_t* self)
+{
+	ASSERT(self);
+
+	if(self->mode != XML_OSTREAM_MODE_BUFFER)
+	{
+		LOGE("invalid mode=%i", self->mode);
+		return 0;
+	}
+
+	// keep the last chunk which is also the largest
+	xml_ostreamBuffer_t* ob = &self->ob;
+	if(ob->iov_count)
+	{
+		void*  base = ob->iov[ob->iov_count - 1].iov_base;
+		size_t size = ob->size;
+
+		--ob->iov_count;
+		xml_ostream_chunkFree(self);
+		ob->iov[0].iov_base = base;
+		ob->iov[0].iov_len  = 0;
+		ob->iov_count       = 1;
+		ob->size            = size;
+	}
+
+	self->state       = XML_OSTREAM_STATE_INIT;
+	self->error       = 0;
+	self->depth       = 0;
+	self->names_len   = 0;
+	self->elems_count = 0;
+	self->wlen        = 0;
+
+	return 1;
+}
@@ -25,7 +25,9 @@
 #define xml_ostream_H
 
 #include <stdio.h>
+#include <sys/uio.h>
 #include <zlib.h>
+#include "xml_stats.h"
 
 typedef struct
 {
@@ -41,17 +43,26 @@ typedef struct
 	char   gzname[256];
 } xml_ostreamGzFile_t;
 
+// the output buffer is a list of chunks where each chunk
+// is allocated with twice the size of the previous chunk
+// (or the size hint) so the output is never copied until
+// a contiguous buffer is requested
+// iov_len is the used length of a chunk and size is the
+// capacity of the last chunk
 typedef struct
 {
-	char* buffer;
-	int   len;
+	struct iovec* iov;
+	int           iov_count;
+	int           iov_size;
+	size_t        size;
+	size_t        hint;
+	size_t        len;
 } xml_ostreamBuffer_t;
 
-typedef struct xml_ostreamElem_s
-{
-	char name[256];
-	struct xml_ostreamElem_s* next;
-} xml_ostreamElem_t;
+// output is assembled in the write buffer and only passed
+// to stdio, zlib or the output buffer when the write buffer
+// is full or when the stream is completed
+#define XML_OSTREAM_WBUF_SIZE 32768
 
 typedef struct
 {
@@ -59,7 +70,22 @@ typedef struct
 	int state;
 	int error;
 	int depth;
-	xml_ostreamElem_t* elem;
+	xml_stats_t* stats;
+
+	// element stack where the null terminated names are
+	// stored in the names arena at the element offsets
+	// and the arena is reused across documents
+	char*   names;
+	size_t  names_len;
+	size_t  names_size;
+	size_t* elems;
+	int     elems_count;
+	int     elems_size;
+
+	// write buffer
+	int  wlen;
+	char wbuf[XML_OSTREAM_WBUF_SIZE];
+
 	union
 	{
 		xml_ostreamFile_t   of;
@@ -72,23 +98,71 @@ xml_ostream_t* xml_ostream_new(const char* fname);
 xml_ostream_t* xml_ostream_newGz(const char* gzname);
 xml_ostream_t* xml_ostream_newFile(FILE* f);
 xml_ostream_t* xml_ostream_newBuffer(void);
+// size_hint is the expected output size which is used to
+// size the first chunk (size_hint=0 uses the default)
+xml_ostream_t* xml_ostream_newBufferHint(size_t size_hint);
 void           xml_ostream_delete(xml_ostream_t** _self);
+// fills the caller owned stats while writing where the
+// stats accumulate until cleared (stats=NULL disables the
+// stats)
+void           xml_ostream_stats(xml_ostream_t* self,
+                                 xml_stats_t* stats);
+
+// selects the kernel which escapes values for all streams
+// where auto selects the fastest kernel supported by the
+// cpu at runtime (returns 0 when the kernel is not
+// supported and should be set before writing)
+// supported checks the kernel without logging an error
+#define XML_OSTREAM_KERNEL_AUTO   0
+#define XML_OSTREAM_KERNEL_SCALAR 1
+#define XML_OSTREAM_KERNEL_SSE2   2
+#define XML_OSTREAM_KERNEL_AVX2   3
+#define XML_OSTREAM_KERNEL_NEON   4
+int            xml_ostream_kernel(int kernel);
+int            xml_ostream_kernelSupported(int kernel);
 int            xml_ostream_begin(xml_ostream_t* self,
                                  const char* name);
 int            xml_ostream_end(xml_ostream_t* self);
+// attribute values and content are escaped directly into
+// the output where all C0 control characters (0x00-0x1F
+// including newlines, tabs and carriage returns) are
+// removed and the n variants take the length of the value
+// which does not need to be null terminated
 int            xml_ostream_attr(xml_ostream_t* self,
                                 const char* name,
                                 const char* val);
+int            xml_ostream_attrn(xml_ostream_t* self,
+                                 const char* name,
+                                 const char* val,
+                                 size_t len);
 int            xml_ostream_attrf(xml_ostream_t* self,
                                  const char* name,
                                  const char* fmt, ...);
 int            xml_ostream_content(xml_ostream_t* self,
                                    const char* content);
+int            xml_ostream_contentn(xml_ostream_t* self,
+                                    const char* content,
+                                    size_t len);
 int            xml_ostream_contentf(xml_ostream_t* self,
                                     const char* fmt, ...);
+// completes the stream and returns a contiguous buffer
+// where the chunks are joined when required and acquire
+// transfers ownership of the buffer to the caller
+// returns NULL when the output exceeds INT_MAX bytes
 const char*    xml_ostream_buffer(xml_ostream_t* self,
                                   int acquire,
                                   int* len);
+// completes the stream and returns the chunks which are
+// owned by the stream for writev/sendmsg without joining
+// the chunks
+const struct iovec*
+               xml_ostream_iovec(xml_ostream_t* self,
+                                 int* count,
+                                 size_t* len);
 int            xml_ostream_complete(xml_ostream_t* self);
+// starts a new document in buffer mode where the output
+// which was not acquired is discarded while the element
+// stack and the largest chunk are kept for reuse
+int            xml_ostream_reset(xml_ostream_t* self);
 
 #endif
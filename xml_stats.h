@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xml_stats_H
+#define xml_stats_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the stats are filled by the istream and ostream when
+// enabled and accumulate until cleared by the caller
+// bytes are the input bytes passed to expat or the bytes
+// written, events are the start and end events delivered
+// or written and the peak buffer is the largest buffered
+// content (istream) or output buffer (ostream)
+// the phase times are the cumulative wall time in seconds
+// for reading and decompressing input or writing output
+// (io), expat tokenization (parse), user callbacks
+// (callback) and buffer allocations (alloc)
+typedef struct
+{
+	int64_t bytes;
+	int64_t events;
+	int64_t allocs;
+	size_t  peak_buffer;
+	int     max_depth;
+
+	double time_io;
+	double time_parse;
+	double time_callback;
+	double time_alloc;
+} xml_stats_t;
+
+void   xml_stats_clear(xml_stats_t* self);
+
+// monotonic wall time in seconds
+double xml_stats_time(void);
+
+#endif
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "xml"
+#include "../libcc/cc_log.h"
+#include "xml_value.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+// maximum number of significant digits in a uint64_t
+#define XML_VALUE_DIGITS 19
+
+// maximum number of significant digits passed to strtod
+// where correct rounding requires at most 768 digits (the
+// longest halfway point between two doubles) and the size
+// includes the sign and exponent
+#define XML_VALUE_STRTOD_DIGITS 800
+#define XML_VALUE_STRTOD_SIZE   (XML_VALUE_STRTOD_DIGITS + 16)
+
+typedef struct
+{
+	int      negative;
+	uint64_t mantissa;
+	int      digits;
+	int      truncated;
+	int      exponent;
+
+	// trimmed number for the strtod fallback
+	const char* start;
+	const char* end;
+} xml_valueDecimal_t;
+
+static const double XML_VALUE_POW10[] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+	1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+	1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const uint64_t XML_VALUE_POW10U[] =
+{
+	1ULL,
+	10ULL,
+	100ULL,
+	1000ULL,
+	10000ULL,
+	100000ULL,
+	1000000ULL,
+	10000000ULL,
+	100000000ULL,
+	1000000000ULL,
+	10000000000ULL,
+	100000000000ULL,
+	1000000000000ULL,
+	10000000000000ULL,
+	100000000000000ULL,
+	1000000000000000ULL,
+	10000000000000000ULL,
+	100000000000000000ULL,
+	1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+static int xml_value_space(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\n') ||
+	       (c == '\r');
+}
+
+static int xml_value_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+#if defined(__BYTE_ORDER__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+// SWAR check and conversion of eight ASCII digits loaded as
+// a little endian uint64_t
+static int xml_value_isEightDigits(uint64_t v)
+{
+	return (((v & 0xF0F0F0F0F0F0F0F0ULL) |
+	         (((v + 0x0606060606060606ULL) &
+	           0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+	        0x3333333333333333ULL);
+}
+
+static uint32_t xml_value_eightDigits(uint64_t v)
+{
+	const uint64_t mask = 0x000000FF000000FFULL;
+	const uint64_t mul1 = 0x000F424000000064ULL;
+	const uint64_t mul2 = 0x0000271000000001ULL;
+
+	v -= 0x3030303030303030ULL;
+	v  = (v*10) + (v >> 8);
+	v  = (((v & mask)*mul1) +
+	      (((v >> 16) & mask)*mul2)) >> 32;
+	return (uint32_t) v;
+}
+
+#define XML_VALUE_SWAR
+
+#endif
+
+static const char*
+xml_value_digits(xml_valueDecimal_t* dec,
+                 const char* p, const char* end,
+                 int fraction)
+{
+	ASSERT(dec);
+	ASSERT(p);
+	ASSERT(end);
+
+	// skip leading zeros which are not significant
+	if(dec->digits == 0)
+	{
+		while((p < end) && (*p == '0'))
+		{
+			if(fraction)
+			{
+				--dec->exponent;
+			}
+			++p;
+		}
+	}
+
+	#ifdef XML_VALUE_SWAR
+	while(((end - p) >= 8) &&
+	      ((dec->digits + 8) <= XML_VALUE_DIGITS))
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(uint64_t));
+		if(xml_value_isEightDigits(v) == 0)
+		{
+			break;
+		}
+
+		dec->mantissa  = 100000000ULL*dec->mantissa +
+		                 xml_value_eightDigits(v);
+		dec->digits   += 8;
+		dec->exponent -= fraction ? 8 : 0;
+		p += 8;
+	}
+	#endif
+
+	while((p < end) && xml_value_digit(*p))
+	{
+		if(dec->digits < XML_VALUE_DIGITS)
+		{
+			dec->mantissa = 10*dec->mantissa +
+			                (uint64_t) (*p - '0');
+			++dec->digits;
+			dec->exponent -= fraction ? 1 : 0;
+		}
+		else
+		{
+			// dropped digits in the integer part scale the
+			// mantissa while dropped fraction digits do not
+			if(*p != '0')
+			{
+				dec->truncated = 1;
+			}
+			dec->exponent += fraction ? 0 : 1;
+		}
+		++p;
+	}
+
+	return p;
+}
+
+static int
+xml_value_decimal(const char* str, xml_valueDecimal_t* dec,
+                  int fraction, int exponent)
+{
+	ASSERT(str);
+	ASSERT(dec);
+
+	memset(dec, 0, sizeof(xml_valueDecimal_t));
+
+	// trim whitespace
+	const char* end = str + strlen(str);
+	while(xml_value_space(*str))
+	{
+		++str;
+	}
+	while((end > str) && xml_value_space(end[-1]))
+	{
+		--end;
+	}
+	dec->start = str;
+	dec->end   = end;
+
+	const char* p = str;
+	if((p < end) && ((*p == '-') || (*p == '+')))
+	{
+		dec->negative = (*p == '-');
+		++p;
+	}
+
+	const char* q = p;
+	p = xml_value_digits(dec, p, end, 0);
+	int count = (int) (p - q);
+
+	if(fraction && (p < end) && (*p == '.'))
+	{
+		++p;
+		q = p;
+		p = xml_value_digits(dec, p, end, 1);
+		count += (int) (p - q);
+	}
+
+	if(count == 0)
+	{
+		return 0;
+	}
+
+	if(exponent && (p < end) && ((*p == 'e') || (*p == 'E')))
+	{
+		++p;
+
+		int negative = 0;
+		if((p < end) && ((*p == '-') || (*p == '+')))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		if((p == end) || (xml_value_digit(*p) == 0))
+		{
+			return 0;
+		}
+
+		// clamp the exponent which is out of range anyway
+		int e = 0;
+		while((p < end) && xml_value_digit(*p))
+		{
+			if(e < 100000)
+			{
+				e = 10*e + (*p - '0');
+			}
+			++p;
+		}
+		dec->exponent += negative ? -e : e;
+	}
+
+	return (p == end) ? 1 : 0;
+}
+
+static int
+xml_value_strtod(xml_valueDecimal_t* dec, double* val)
+{
+	ASSERT(dec);
+	ASSERT(val);
+
+	// strtod expects the decimal point of the current
+	// locale so the number is rewritten on the stack as an
+	// integer of the significant digits and an exponent
+	// which avoids the decimal point
+	char    buf[XML_VALUE_STRTOD_SIZE];
+	int     len      = 0;
+	int     digits   = 0;
+	int     sticky   = 0;
+	int64_t exponent = 0;
+	int     fraction = 0;
+	if(dec->negative)
+	{
+		buf[len++] = '-';
+	}
+
+	const char* p;
+	for(p = dec->start; (p < dec->end) && (*p != 'e') &&
+	    (*p != 'E'); ++p)
+	{
+		char c = *p;
+		if(c == '.')
+		{
+			fraction = 1;
+			continue;
+		}
+		else if(xml_value_digit(c) == 0)
+		{
+			continue;
+		}
+
+		exponent -= fraction ? 1 : 0;
+
+		// skip leading zeros and fold the digits beyond the
+		// limit into the exponent where a nonzero digit is
+		// kept as a sticky digit
+		if((digits == 0) && (c == '0'))
+		{
+			continue;
+		}
+		else if(digits < (XML_VALUE_STRTOD_DIGITS - 1))
+		{
+			buf[len++] = c;
+			++digits;
+		}
+		else
+		{
+			sticky   |= (c != '0');
+			exponent += 1;
+		}
+	}
+
+	if(digits == 0)
+	{
+		*val = dec->negative ? -0.0 : 0.0;
+		return 1;
+	}
+
+	if(sticky)
+	{
+		buf[len++] = '1';
+		exponent  -= 1;
+	}
+	else
+	{
+		// trailing zeros are not significant
+		while(buf[len - 1] == '0')
+		{
+			--len;
+			exponent += 1;
+		}
+	}
+
+	// add the exponent which is clamped since the value is
+	// out of range anyway
+	if((p < dec->end) && ((*p == 'e') || (*p == 'E')))
+	{
+		++p;
+
+		int negative = 0;
+		if((p < dec->end) && ((*p == '-') || (*p == '+')))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		int e = 0;
+		while((p < dec->end) && xml_value_digit(*p))
+		{
+			if(e < 100000)
+			{
+				e = 10*e + (*p - '0');
+			}
+			++p;
+		}
+		exponent += negative ? -e : e;
+	}
+
+	if(exponent > 1000000)
+	{
+		exponent = 1000000;
+	}
+	else if(exponent < -1000000)
+	{
+		exponent = -1000000;
+	}
+	len += snprintf(&buf[len], XML_VALUE_STRTOD_SIZE - len,
+	                "e%i", (int) exponent);
+
+	errno = 0;
+	char*  endptr = NULL;
+	double d      = strtod(buf, &endptr);
+	if((endptr != &buf[len]) ||
+	   ((errno == ERANGE) && ((d == HUGE_VAL) ||
+	                          (d == -HUGE_VAL))))
+	{
+		return 0;
+	}
+
+	*val = d;
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+const char* xml_value_attr(const char** atts,
+                           const char* name)
+{
+	ASSERT(atts);
+	ASSERT(name);
+
+	int i = 0;
+	while(atts[i] && atts[i + 1])
+	{
+		if(strcmp(atts[i], name) == 0)
+		{
+			return atts[i + 1];
+		}
+		i += 2;
+	}
+
+	return NULL;
+}
+
+int xml_value_attrInt(const char** atts,
+                      const char* name,
+                      int* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_int(str, val) : 0;
+}
+
+int xml_value_attrInt64(const char** atts,
+                        const char* name,
+                        int64_t* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_int64(str, val) : 0;
+}
+
+int xml_value_attrDouble(const char** atts,
+                         const char* name,
+                         double* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_double(str, val) : 0;
+}
+
+int xml_value_attrFloat(const char** atts,
+                        const char* name,
+                        float* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_float(str, val) : 0;
+}
+
+int xml_value_attrBool(const char** atts,
+                       const char* name,
+                       int* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_bool(str, val) : 0;
+}
+
+int xml_value_attrFixed(const char** atts,
+                        const char* name,
+                        int digits,
+                        int64_t* val)
+{
+	ASSERT(atts);
+	ASSERT(name);
+	ASSERT(val);
+
+	const char* str = xml_value_attr(atts, name);
+	return str ? xml_value_fixed(str, digits, val) : 0;
+}
+
+int xml_value_int(const char* str, int* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	int64_t v;
+	if((xml_value_int64(str, &v) == 0) ||
+	   (v < INT_MIN) || (v > INT_MAX))
+	{
+		return 0;
+	}
+
+	*val = (int) v;
+	return 1;
+}
+
+int xml_value_int64(const char* str, int64_t* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	xml_valueDecimal_t dec;
+	if((xml_value_decimal(str, &dec, 0, 0) == 0) ||
+	   dec.truncated || (dec.exponent != 0))
+	{
+		return 0;
+	}
+
+	if(dec.negative)
+	{
+		if(dec.mantissa > 9223372036854775808ULL)
+		{
+			return 0;
+		}
+		*val = (int64_t) (0 - dec.mantissa);
+	}
+	else
+	{
+		if(dec.mantissa > 9223372036854775807ULL)
+		{
+			return 0;
+		}
+		*val = (int64_t) dec.mantissa;
+	}
+
+	return 1;
+}
+
+int xml_value_double(const char* str, double* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	xml_valueDecimal_t dec;
+	if(xml_value_decimal(str, &dec, 1, 1) == 0)
+	{
+		// XML schema special values
+		if((dec.end - dec.start) > 4)
+		{
+			return 0;
+		}
+
+		char buf[5];
+		memcpy(buf, dec.start, dec.end - dec.start);
+		buf[dec.end - dec.start] = '\0';
+		if((strcmp(buf, "INF") == 0) ||
+		   (strcmp(buf, "+INF") == 0))
+		{
+			*val = HUGE_VAL;
+			return 1;
+		}
+		else if(strcmp(buf, "-INF") == 0)
+		{
+			*val = -HUGE_VAL;
+			return 1;
+		}
+		else if(strcmp(buf, "NaN") == 0)
+		{
+			*val = NAN;
+			return 1;
+		}
+		return 0;
+	}
+
+	// Clinger's fast path is exact when the mantissa and the
+	// power of ten are exactly representable as doubles
+	if(dec.mantissa == 0)
+	{
+		*val = dec.negative ? -0.0 : 0.0;
+		return 1;
+	}
+	else if((dec.truncated == 0)                   &&
+	        (dec.mantissa <= 9007199254740992ULL) &&
+	        (dec.exponent >= -22) && (dec.exponent <= 22))
+	{
+		double d = (double) dec.mantissa;
+		if(dec.exponent < 0)
+		{
+			d /= XML_VALUE_POW10[-dec.exponent];
+		}
+		else
+		{
+			d *= XML_VALUE_POW10[dec.exponent];
+		}
+		*val = dec.negative ? -d : d;
+		return 1;
+	}
+
+	return xml_value_strtod(&dec, val);
+}
+
+int xml_value_float(const char* str, float* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	double d;
+	if(xml_value_double(str, &d) == 0)
+	{
+		return 0;
+	}
+
+	if(isfinite(d) && ((d > FLT_MAX) || (d < -FLT_MAX)))
+	{
+		return 0;
+	}
+
+	*val = (float) d;
+	return 1;
+}
+
+int xml_value_bool(const char* str, int* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	// trim whitespace
+	const char* end = str + strlen(str);
+	while(xml_value_space(*str))
+	{
+		++str;
+	}
+	while((end > str) && xml_value_space(end[-1]))
+	{
+		--end;
+	}
+
+	size_t len = (size_t) (end - str);
+	if(((len == 4) && (strncmp(str, "true", 4) == 0)) ||
+	   ((len == 1) && (str[0] == '1')))
+	{
+		*val = 1;
+		return 1;
+	}
+	else if(((len == 5) && (strncmp(str, "false", 5) == 0)) ||
+	        ((len == 1) && (str[0] == '0')))
+	{
+		*val = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+int xml_value_fixed(const char* str, int digits,
+                    int64_t* val)
+{
+	ASSERT(str);
+	ASSERT(val);
+
+	if((digits < 0) || (digits > 18))
+	{
+		LOGE("invalid digits=%i", digits);
+		return 0;
+	}
+
+	xml_valueDecimal_t dec;
+	if(xml_value_decimal(str, &dec, 1, 1) == 0)
+	{
+		return 0;
+	}
+
+	uint64_t m     = dec.mantissa;
+	int      shift = dec.exponent + digits;
+	if(m == 0)
+	{
+		// zero
+	}
+	else if(shift >= 0)
+	{
+		if((shift > XML_VALUE_DIGITS) ||
+		   (m > (UINT64_MAX/XML_VALUE_POW10U[shift])))
+		{
+			return 0;
+		}
+		m *= XML_VALUE_POW10U[shift];
+	}
+	else if(-shift > XML_VALUE_DIGITS)
+	{
+		m = 0;
+	}
+	else
+	{
+		// round half away from zero
+		uint64_t p = XML_VALUE_POW10U[-shift];
+		uint64_t r = m%p;
+		m /= p;
+		if(r >= (p - r))
+		{
+			++m;
+		}
+	}
+
+	if(dec.negative)
+	{
+		if(m > 9223372036854775808ULL)
+		{
+			return 0;
+		}
+		*val = (int64_t) (0 - m);
+	}
+	else
+	{
+		if(m > 9223372036854775807ULL)
+		{
+			return 0;
+		}
+		*val = (int64_t) m;
+	}
+
+	return 1;
+}
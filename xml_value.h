@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef xml_value_H
+#define xml_value_H
+
+#include <stdint.h>
+
+// typed decoding of attribute values and element content
+// the decoders are locale independent, do not allocate
+// memory, accept leading/trailing whitespace and return 0
+// without modifying val when the string is invalid or when
+// the value is out of range
+
+const char* xml_value_attr(const char** atts,
+                           const char* name);
+int         xml_value_attrInt(const char** atts,
+                              const char* name,
+                              int* val);
+int         xml_value_attrInt64(const char** atts,
+                                const char* name,
+                                int64_t* val);
+int         xml_value_attrDouble(const char** atts,
+                                 const char* name,
+                                 double* val);
+int         xml_value_attrFloat(const char** atts,
+                                const char* name,
+                                float* val);
+int         xml_value_attrBool(const char** atts,
+                               const char* name,
+                               int* val);
+int         xml_value_attrFixed(const char** atts,
+                                const char* name,
+                                int digits,
+                                int64_t* val);
+int         xml_value_int(const char* str, int* val);
+int         xml_value_int64(const char* str, int64_t* val);
+int         xml_value_double(const char* str, double* val);
+int         xml_value_float(const char* str, float* val);
+int         xml_value_bool(const char* str, int* val);
+
+// decodes a decimal number scaled by 10^digits and rounded
+// to the nearest integer (e.g. "12.34567" with 3 digits
+// is 12346)
+int         xml_value_fixed(const char* str, int digits,
+                            int64_t* val);
+
+#endif